@@ -0,0 +1,111 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    autotests/assuanoptionsbenchmark.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+#include "utils/assuanoptions.h"
+#include "utils/hex.h"
+
+#include <QByteArray>
+#include <QTest>
+
+#include <cstring>
+#include <string>
+
+using namespace Kleo;
+
+class AssuanOptionsBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testParse()
+    {
+        QByteArray line("--protocol=OpenPGP  --nohup FILE=%2Ftmp%2Fa+b\t--text");
+        AssuanOptions options;
+        parseAssuanOptions(line.data(), options);
+        QCOMPARE(options.size(), 4);
+        QCOMPARE(options[0].name, "protocol");
+        QCOMPARE(options[0].value, "OpenPGP");
+        QCOMPARE(options[1].name, "nohup");
+        QCOMPARE(options[1].value, "");
+        QVERIFY(findAssuanOption(options, "file", false));
+        QCOMPARE(findAssuanOption(options, "file", false)->value, "/tmp/a b");
+        QVERIFY(!findAssuanOption(options, "file"));
+    }
+
+    void testHexRoundTrip()
+    {
+        // control chars are encoded as '+', so they don't round-trip
+        QCOMPARE(hexencode(std::string("a\x01" "b")), std::string("a+b"));
+
+        const std::string plain("x\"#$%'+= y\xe4");
+        QCOMPARE(hexencode(plain), std::string("x%22%23%24%25%27%2B%3D+y\xe4"));
+        QCOMPARE(hexdecode(hexencode(plain)), plain);
+        const QByteArray qplain(plain.c_str());
+        QCOMPARE(hexdecode(hexencode(qplain)), qplain);
+    }
+
+    void benchmarkParse()
+    {
+        const QByteArray line("--protocol=OpenPGP --mode=email --nohup --window-id=0x1234 "
+                              "--text=Some%20text+with%25escapes FILE=%2Fhome%2Fuser%2FDocuments%2Ffile.txt");
+        QByteArray copy;
+        AssuanOptions options;
+        QBENCHMARK {
+            copy = line;
+            parseAssuanOptions(copy.data(), options);
+        }
+        QCOMPARE(options.size(), 6);
+    }
+
+    void benchmarkHexDecode()
+    {
+        const QByteArray encoded = QByteArray("%2Fhome%2Fuser%2FDocuments+and+Settings%2Ffile%25name.txt").repeated(16);
+        QByteArray decoded;
+        QBENCHMARK {
+            decoded = hexdecode(encoded);
+        }
+        QVERIFY(decoded.startsWith("/home/user/Documents and Settings/file%name.txt"));
+    }
+
+    void benchmarkHexEncode()
+    {
+        const QByteArray plain = QByteArray("/home/user/Documents and Settings/file%name=1.txt").repeated(16);
+        QByteArray encoded;
+        QBENCHMARK {
+            encoded = hexencode(plain);
+        }
+        QCOMPARE(hexdecode(encoded), plain);
+    }
+};
+
+QTEST_GUILESS_MAIN(AssuanOptionsBenchmark)
+
+#include "assuanoptionsbenchmark.moc"
@@ -40,6 +40,7 @@
 #include "exportopenpgpcertstoservercommand.h"
 #include "dialogs/certifycertificatedialog.h"
 #include "utils/remarks.h"
+#include "utils/keyringwatcher.h"
 
 #include <Libkleo/KeyCache>
 #include <Libkleo/Formatting>
@@ -277,6 +278,12 @@ void CertifyCertificateCommand::Private::slotDialogRejected()
 
 void CertifyCertificateCommand::Private::slotResult(const Error &err)
 {
+    // a new certification of a key with owner trust changes the validity
+    // of the keys certified by it, too
+    const bool affectsOthers = !err && key().ownerTrust() >= Key::Marginal;
+    KeyRingWatcher::mutableInstance()->endChange(std::vector<Key>(1, key()), affectsOthers ? KeyRingWatcher::Validity
+                                                                                          : KeyRingWatcher::AffectedKeys);
+
     if (!err && !err.isCanceled() && dialog && dialog->exportableCertificationSelected() && dialog->sendToServer()) {
         ExportOpenPGPCertsToServerCommand *const cmd = new ExportOpenPGPCertsToServerCommand(key());
         cmd->start();
@@ -314,6 +321,7 @@ void CertifyCertificateCommand::Private::slotCertificationPrepared()
     job->setDupeOk(true);
 #endif
 
+    KeyRingWatcher::mutableInstance()->beginChange();
     if (const Error err = job->start(key())) {
         slotResult(err);
     }
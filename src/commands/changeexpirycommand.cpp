@@ -38,6 +38,8 @@
 
 #include <dialogs/expirydialog.h>
 
+#include <utils/keyringwatcher.h>
+
 #include <Libkleo/Formatting>
 
 #include <QGpgME/Protocol>
@@ -176,7 +178,9 @@ void ChangeExpiryCommand::Private::slotDialogAccepted()
     createJob();
     Q_ASSERT(job);
 
+    KeyRingWatcher::mutableInstance()->beginChange();
     if (const Error err = job->start(key, expiry)) {
+        KeyRingWatcher::mutableInstance()->endChange(std::vector<Key>(1, key));
         showErrorDialog(err);
         finished();
     }
@@ -190,6 +194,8 @@ void ChangeExpiryCommand::Private::slotDialogRejected()
 
 void ChangeExpiryCommand::Private::slotResult(const Error &err)
 {
+    KeyRingWatcher::mutableInstance()->endChange(std::vector<Key>(1, key));
+
     if (err.isCanceled())
         ;
     else if (err) {
@@ -38,6 +38,7 @@
 #include <Libkleo/KeyCache>
 
 #include <utils/gnupg-helper.h>
+#include <utils/keyringwatcher.h>
 
 #include "kleopatra_debug.h"
 #include <KLocalizedString>
@@ -93,7 +94,9 @@ private:
 private:
     void slotOperationFinished()
     {
-        KeyCache::mutableInstance()->enableFileSystemWatcher(true);
+        // the trust list affects the validity of all CMS keys, so
+        // don't let the watcher refresh just this one:
+        KeyRingWatcher::mutableInstance()->endChange(QStringList());
         if (error.isEmpty()) {
             KeyCache::mutableInstance()->reload(GpgME::CMS);
         } else
@@ -196,7 +199,7 @@ void ChangeRootTrustCommand::doStart()
     }
 
     d->gpgConfPath = gpgConfPath();
-    KeyCache::mutableInstance()->enableFileSystemWatcher(false);
+    KeyRingWatcher::mutableInstance()->beginChange();
     d->start();
 }
 
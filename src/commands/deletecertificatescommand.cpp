@@ -38,6 +38,8 @@
 
 #include <dialogs/deletecertificatesdialog.h>
 
+#include <utils/keyringwatcher.h>
+
 #include <Libkleo/KeyCache>
 #include <Libkleo/Predicates>
 
@@ -377,7 +379,9 @@ void DeleteCertificatesCommand::Private::startDeleteJob(GpgME::Protocol protocol
     connect(job.get(), &Job::progress,
             q, &Command::progress);
 
+    KeyRingWatcher::mutableInstance()->beginChange();
     if (const Error err = job->start(keys, true /*allowSecretKeyDeletion*/)) {
+        KeyRingWatcher::mutableInstance()->endChange(keys);
         (protocol == CMS ? cmsError : pgpError) = err;
     } else {
         (protocol == CMS ? cmsJob : pgpJob) = job.release();
@@ -422,6 +426,8 @@ void DeleteCertificatesCommand::Private::pgpDeleteResult(const Error &err)
 {
     pgpError = err;
     pgpJob = nullptr;
+    // also catches keys MultiDeleteJob deleted before it failed:
+    KeyRingWatcher::mutableInstance()->endChange(pgpKeys);
     if (!cmsJob) {
         showErrorsAndFinish();
     }
@@ -431,6 +437,7 @@ void DeleteCertificatesCommand::Private::cmsDeleteResult(const Error &err)
 {
     cmsError = err;
     cmsJob = nullptr;
+    KeyRingWatcher::mutableInstance()->endChange(cmsKeys);
     if (!pgpJob) {
         showErrorsAndFinish();
     }
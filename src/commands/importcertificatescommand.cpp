@@ -39,6 +39,8 @@
 #include "certifycertificatecommand.h"
 #include "kleopatra_debug.h"
 
+#include <utils/keyringwatcher.h>
+
 #include <Libkleo/KeyListSortFilterProxyModel>
 #include <Libkleo/KeyCache>
 #include <Libkleo/Predicates>
@@ -457,6 +459,19 @@ void ImportCertificatesCommand::Private::importResult(const ImportResult &result
 
     jobs.erase(std::remove(jobs.begin(), jobs.end(), q->sender()), jobs.end());
 
+    QStringList fingerprints;
+    bool newCertifications = false;
+    for (const Import &import : result.imports()) {
+        if (import.fingerprint()) {
+            fingerprints.push_back(QLatin1String(import.fingerprint()));
+        }
+        // (a new key may still have an owner trust from earlier)
+        newCertifications = newCertifications || (import.status() & (Import::NewKey | Import::NewSignatures));
+    }
+    // new keys and signatures can change the validity of keys already known
+    KeyRingWatcher::mutableInstance()->endChange(fingerprints, newCertifications ? KeyRingWatcher::Validity
+                                                                                : KeyRingWatcher::AffectedKeys);
+
     importResult(result, idsByJob[q->sender()]);
 }
 
@@ -641,6 +656,7 @@ void ImportCertificatesCommand::Private::startImport(GpgME::Protocol protocol, c
     if (err.code()) {
         importResult(ImportResult(err), id);
     } else {
+        KeyRingWatcher::mutableInstance()->beginChange();
         jobs.push_back(job.release());
         idsByJob[jobs.back()] = id;
     }
@@ -686,6 +702,7 @@ void ImportCertificatesCommand::Private::startImport(GpgME::Protocol protocol, c
     if (err.code()) {
         importResult(ImportResult(err), id);
     } else {
+        KeyRingWatcher::mutableInstance()->beginChange();
         jobs.push_back(job.release());
         idsByJob[jobs.back()] = id;
     }
@@ -51,11 +51,26 @@
 #include <selftest/gpgagentcheck.h>
 #include <selftest/libkleopatrarccheck.h>
 
+#include <utils/gnupg-helper.h>
+
 #include <Libkleo/Stl_Util>
 
 #include <KConfigGroup>
 #include <KSharedConfig>
 
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QThread>
+
+#include <gpgme++/engineinfo.h>
+
+#include <algorithm>
+#include <functional>
 #include <vector>
 
 #include <QGpgME/CryptoConfig>
@@ -75,6 +90,68 @@ static const char *const components[] = {
 };
 static const unsigned int numComponents = sizeof components / sizeof * components;
 
+static const char *const configFiles[] = {
+    "gpgconf.conf",
+    "gpg.conf",
+    "gpg-agent.conf",
+    "scdaemon.conf",
+    "gpgsm.conf",
+    "dirmngr.conf",
+};
+
+// Identifies what the self-tests ran against: the engine binaries
+// (path, mtime and version) and the configuration files they check.
+static QString installation_fingerprint()
+{
+    QStringList parts;
+    const auto addFile = [&parts](const QString &fileName) {
+        const QFileInfo fi(fileName);
+        parts << fileName << (fi.exists() ? QString::number(fi.lastModified().toMSecsSinceEpoch()) : QString());
+    };
+    for (const GpgME::Engine engine : { GpgME::GpgEngine, GpgME::GpgSMEngine, GpgME::GpgConfEngine }) {
+        const GpgME::EngineInfo ei = GpgME::engineInfo(engine);
+        addFile(QFile::decodeName(ei.fileName()));
+        parts << QString::fromLatin1(ei.version());
+    }
+    const QDir homeDir(gnupgHomeDirectory());
+    for (const char *configFile : configFiles) {
+        addFile(homeDir.absoluteFilePath(QLatin1String(configFile)));
+    }
+    const QStringList rcFiles = QStandardPaths::locateAll(QStandardPaths::GenericConfigLocation, QStringLiteral("libkleopatrarc"));
+    for (const QString &fileName : rcFiles) {
+        addFile(fileName);
+    }
+    return QString::fromLatin1(QCryptographicHash::hash(parts.join(QLatin1Char('\n')).toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+namespace
+{
+// Creates (and thereby runs) a group of self-tests in its own thread.
+class SelfTestThread : public QThread
+{
+public:
+    typedef std::vector< std::shared_ptr<Kleo::SelfTest> > Tests;
+
+    explicit SelfTestThread(const std::function<Tests()> &factory)
+        : QThread(), m_factory(factory) {}
+
+    const Tests &tests() const
+    {
+        return m_tests;
+    }
+
+private:
+    void run() override
+    {
+        m_tests = m_factory();
+    }
+
+private:
+    const std::function<Tests()> m_factory;
+    Tests m_tests;
+};
+}
+
 class SelfTestCommand::Private : Command::Private
 {
     friend class ::Kleo::Commands::SelfTestCommand;
@@ -131,9 +208,54 @@ private:
         config.writeEntry("run-at-startup", on);
     }
 
+    bool cachedPassIsValid() const
+    {
+        const KConfigGroup config(KSharedConfig::openConfig(), "Self-Test");
+        const QString passed = config.readEntry("passed-for", QString());
+        return !passed.isEmpty() && passed == installation_fingerprint();
+    }
+
+    void setCachedPass(bool passed)
+    {
+        KConfigGroup config(KSharedConfig::openConfig(), "Self-Test");
+        if (passed) {
+            config.writeEntry("passed-for", installation_fingerprint());
+        } else {
+            config.deleteEntry("passed-for");
+        }
+    }
+
+    void startThread(const std::function<SelfTestThread::Tests()> &factory)
+    {
+        const std::shared_ptr<SelfTestThread> thread(new SelfTestThread(factory));
+        QObject::connect(thread.get(), &QThread::finished, q_func(), [this]() {
+            slotThreadFinished();
+        });
+        threads.push_back(thread);
+        thread->start();
+    }
+
+    void slotThreadFinished()
+    {
+        if (--runningThreads) {
+            return;
+        }
+        for (const std::shared_ptr<SelfTestThread> &thread : threads) {
+            thread->wait();
+            tests.insert(tests.end(), thread->tests().begin(), thread->tests().end());
+        }
+        threads.clear();
+        if (!canceled) {
+            testsDone();
+        }
+    }
+
     void runTests()
     {
-        std::vector< std::shared_ptr<Kleo::SelfTest> > tests;
+        if (runningThreads) {
+            return;
+        }
+        tests.clear();
 
 #if defined(Q_OS_WIN)
         qCDebug(KLEOPATRA_LOG) << "Checking Windows Registry...";
@@ -143,25 +265,45 @@ private:
         tests.push_back(makeUiServerConnectivitySelfTest());
 #endif
 #endif
-        qCDebug(KLEOPATRA_LOG) << "Checking gpg installation...";
-        tests.push_back(makeGpgEngineCheckSelfTest());
-        qCDebug(KLEOPATRA_LOG) << "Checking gpgsm installation...";
-        tests.push_back(makeGpgSmEngineCheckSelfTest());
-        qCDebug(KLEOPATRA_LOG) << "Checking gpgconf installation...";
-        tests.push_back(makeGpgConfEngineCheckSelfTest());
+
+        // The remaining checks only spawn processes and read files; none
+        // of them uses the (not thread-safe) CryptoConfig. Run them
+        // concurrently, in the order their results are shown in:
+        startThread([]() {
+            qCDebug(KLEOPATRA_LOG) << "Checking gpg, gpgsm and gpgconf installation...";
+            return SelfTestThread::Tests{
+                makeGpgEngineCheckSelfTest(),
+                makeGpgSmEngineCheckSelfTest(),
+                makeGpgConfEngineCheckSelfTest(),
+            };
+        });
         for (unsigned int i = 0; i < numComponents; ++i) {
-            qCDebug(KLEOPATRA_LOG) << "Checking configuration of:" << components[i];
-            tests.push_back(makeGpgConfCheckConfigurationSelfTest(components[i]));
+            const char *const component = components[i];
+            startThread([component]() {
+                qCDebug(KLEOPATRA_LOG) << "Checking configuration of:" << component;
+                return SelfTestThread::Tests(1, makeGpgConfCheckConfigurationSelfTest(component));
+            });
         }
 #ifndef Q_OS_WIN
-        tests.push_back(makeGpgAgentConnectivitySelfTest());
+        startThread([]() {
+            return SelfTestThread::Tests(1, makeGpgAgentConnectivitySelfTest());
+        });
 #endif
-        tests.push_back(makeLibKleopatraRcSelfTest());
+        startThread([]() {
+            return SelfTestThread::Tests(1, makeLibKleopatraRcSelfTest());
+        });
+        runningThreads = threads.size();
+    }
+
+    void testsDone()
+    {
+        const bool passed = std::none_of(tests.cbegin(), tests.cend(),
+                                         [](const std::shared_ptr<SelfTest> &test) {
+                                             return test->failed();
+                                         });
+        setCachedPass(passed);
 
-        if (!dialog && std::none_of(tests.cbegin(), tests.cend(),
-                                    [](const std::shared_ptr<SelfTest> &test) {
-                                        return test->failed();
-                                    })) {
+        if (!dialog && passed) {
             finished();
             return;
         }
@@ -191,6 +333,9 @@ private:
     }
     void slotUpdateRequested()
     {
+        if (runningThreads) {
+            return;
+        }
         const auto conf = QGpgME::cryptoConfig();
         if (conf) {
             conf->clear();
@@ -200,8 +345,13 @@ private:
 
 private:
     QPointer<SelfTestDialog> dialog;
+    std::vector< std::shared_ptr<Kleo::SelfTest> > tests;
+    std::vector< std::shared_ptr<SelfTestThread> > threads;
+    unsigned int runningThreads;
     bool canceled;
     bool automatic;
+    bool useCachedResults;
+    bool usedCachedResults;
 };
 
 SelfTestCommand::Private *SelfTestCommand::d_func()
@@ -219,15 +369,20 @@ const SelfTestCommand::Private *SelfTestCommand::d_func() const
 SelfTestCommand::Private::Private(SelfTestCommand *qq, KeyListController *c)
     : Command::Private(qq, c),
       dialog(),
+      runningThreads(0),
       canceled(false),
-      automatic(false)
+      automatic(false),
+      useCachedResults(true),
+      usedCachedResults(false)
 {
 
 }
 
 SelfTestCommand::Private::~Private()
 {
-
+    for (const std::shared_ptr<SelfTestThread> &thread : threads) {
+        thread->wait();
+    }
 }
 
 SelfTestCommand::SelfTestCommand(KeyListController *c)
@@ -262,6 +417,16 @@ bool SelfTestCommand::isCanceled() const
     return d->canceled;
 }
 
+void SelfTestCommand::setUseCachedResults(bool on)
+{
+    d->useCachedResults = on;
+}
+
+bool SelfTestCommand::usedCachedResults() const
+{
+    return d->usedCachedResults;
+}
+
 void SelfTestCommand::doStart()
 {
 
@@ -270,6 +435,12 @@ void SelfTestCommand::doStart()
             d->finished();
             return;
         }
+        if (d->useCachedResults && d->cachedPassIsValid()) {
+            qCDebug(KLEOPATRA_LOG) << "Self-tests passed before, skipping them";
+            d->usedCachedResults = true;
+            d->finished();
+            return;
+        }
     } else {
         d->ensureDialogCreated();
     }
@@ -50,6 +50,11 @@ public:
 
     void setAutomaticMode(bool automatic);
 
+    // in automatic mode, skip the tests if they passed before against
+    // the same installation (default: true)
+    void setUseCachedResults(bool use);
+    bool usedCachedResults() const;
+
     bool isCanceled() const;
 
 private:
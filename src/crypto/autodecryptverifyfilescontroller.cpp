@@ -65,6 +65,7 @@
 #include <QFileDialog>
 #include <QTemporaryDir>
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -108,7 +109,7 @@ public:
     QStringList m_passedFiles, m_filesAfterPreparation;
     std::vector<std::shared_ptr<const DecryptVerifyResult> > m_results;
     std::vector<std::shared_ptr<Task> > m_runnableTasks, m_completedTasks;
-    std::shared_ptr<Task> m_runningTask;
+    std::vector<std::shared_ptr<Task> > m_runningTasks;
     bool m_errorDetected;
     DecryptVerifyOperation m_operation;
     DecryptVerifyFilesDialog *m_dialog;
@@ -131,13 +132,13 @@ void AutoDecryptVerifyFilesController::Private::slotDialogCanceled()
 
 void AutoDecryptVerifyFilesController::Private::schedule()
 {
-    if (!m_runningTask && !m_runnableTasks.empty()) {
+    while (m_runningTasks.size() < q->maximumConcurrentTasks() && !m_runnableTasks.empty()) {
         const std::shared_ptr<Task> t = m_runnableTasks.back();
         m_runnableTasks.pop_back();
+        m_runningTasks.push_back(t);
         t->start();
-        m_runningTask = t;
     }
-    if (!m_runningTask) {
+    if (m_runningTasks.empty()) {
         kleo_assert(m_runnableTasks.empty());
         for (const std::shared_ptr<const DecryptVerifyResult> &i : qAsConst(m_results)) {
             Q_EMIT q->verificationResult(i->verificationResult());
@@ -508,9 +509,11 @@ void AutoDecryptVerifyFilesController::Private::cancelAllTasks()
     // signal emissions.
     m_runnableTasks.clear();
 
-    // a cancel() will result in a call to
-    if (m_runningTask) {
-        m_runningTask->cancel();
+    // a cancel() will result in a call to doTaskDone(), which
+    // modifies m_runningTasks, so iterate over a copy:
+    const std::vector<std::shared_ptr<Task> > running = m_runningTasks;
+    for (const std::shared_ptr<Task> &t : running) {
+        t->cancel();
     }
 }
 
@@ -531,15 +534,18 @@ void AutoDecryptVerifyFilesController::cancel()
 void AutoDecryptVerifyFilesController::doTaskDone(const Task *task, const std::shared_ptr<const Task::Result> &result)
 {
     Q_ASSERT(task);
-    Q_UNUSED(task);
 
     // We could just delete the tasks here, but we can't use
     // Qt::QueuedConnection here (we need sender()) and other slots
     // might not yet have executed. Therefore, we push completed tasks
     // into a burial container
 
-    d->m_completedTasks.push_back(d->m_runningTask);
-    d->m_runningTask.reset();
+    const auto it = std::find_if(d->m_runningTasks.begin(), d->m_runningTasks.end(),
+                                 [task](const std::shared_ptr<Task> &t) { return t.get() == task; });
+    if (it != d->m_runningTasks.end()) {
+        d->m_completedTasks.push_back(*it);
+        d->m_runningTasks.erase(it);
+    }
 
     if (const std::shared_ptr<const DecryptVerifyResult> &dvr = std::dynamic_pointer_cast<const DecryptVerifyResult>(result)) {
         d->m_results.push_back(dvr);
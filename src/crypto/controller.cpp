@@ -46,7 +46,8 @@ public:
     explicit Private(Controller *qq)
         : q(qq),
           lastError(0),
-          lastErrorString()
+          lastErrorString(),
+          maximumConcurrentTasks(1)
     {
 
     }
@@ -54,6 +55,7 @@ public:
 private:
     int lastError;
     QString lastErrorString;
+    unsigned int maximumConcurrentTasks;
 };
 
 Controller::Controller(QObject *parent)
@@ -74,9 +76,20 @@ void Controller::taskDone(const std::shared_ptr<const Task::Result> &result)
 {
     const Task *task = qobject_cast<const Task *>(sender());
     Q_ASSERT(task);
+    Q_EMIT taskCompleted(task->label(), result);
     doTaskDone(task, result);
 }
 
+void Controller::setMaximumConcurrentTasks(unsigned int max)
+{
+    d->maximumConcurrentTasks = qMax(1U, max);
+}
+
+unsigned int Controller::maximumConcurrentTasks() const
+{
+    return d->maximumConcurrentTasks;
+}
+
 void Controller::doTaskDone(const Task *, const std::shared_ptr<const Task::Result> &) {}
 
 void Controller::connectTask(const std::shared_ptr<Task> &task)
@@ -57,8 +57,17 @@ public:
 
     using ExecutionContextUser::setExecutionContext;
 
+    /*!
+      Sets the number of tasks the controller runs in parallel (per
+      protocol, where the controller schedules per protocol). Defaults
+      to 1.
+    */
+    void setMaximumConcurrentTasks(unsigned int max);
+    unsigned int maximumConcurrentTasks() const;
+
 Q_SIGNALS:
     void progress(int current, int total, const QString &what);
+    void taskCompleted(const QString &label, const std::shared_ptr<const Kleo::Crypto::Task::Result> &result);
 
 protected:
     void emitDoneOrError();
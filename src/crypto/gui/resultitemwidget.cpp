@@ -68,10 +68,7 @@ using namespace Kleo;
 using namespace Kleo::Crypto;
 using namespace Kleo::Crypto::Gui;
 
-namespace
-{
-// TODO move out of here
-static QColor colorForVisualCode(Task::Result::VisualCode code)
+QColor Kleo::Crypto::Gui::colorForVisualCode(Task::Result::VisualCode code)
 {
     switch (code) {
     case Task::Result::AllGood:
@@ -86,7 +83,8 @@ static QColor colorForVisualCode(Task::Result::VisualCode code)
         return QColor(0x00, 0x80, 0xFF); // light blue
     }
 }
-static QColor txtColorForVisualCode(Task::Result::VisualCode code)
+
+QColor Kleo::Crypto::Gui::txtColorForVisualCode(Task::Result::VisualCode code)
 {
     switch (code) {
     case Task::Result::AllGood:
@@ -101,7 +99,6 @@ static QColor txtColorForVisualCode(Task::Result::VisualCode code)
         return QColor(0xFF, 0xFF, 0xFF); // white
     }
 }
-}
 
 class ResultItemWidget::Private
 {
@@ -41,6 +41,7 @@
 
 #include <memory>
 
+class QColor;
 class QString;
 
 namespace Kleo
@@ -53,6 +54,9 @@ class Task;
 namespace Gui
 {
 
+QColor colorForVisualCode(Task::Result::VisualCode code);
+QColor txtColorForVisualCode(Task::Result::VisualCode code);
+
 class ResultItemWidget : public QWidget
 {
     Q_OBJECT
@@ -37,25 +37,243 @@
 #include "emailoperationspreferences.h"
 
 #include <crypto/gui/resultitemwidget.h>
+#include <crypto/decryptverifytask.h>
 #include <crypto/taskcollection.h>
 
 #include <utils/scrollarea.h>
 
 #include <Libkleo/Stl_Util>
 
+#include <gpgme++/verificationresult.h>
+
 #include <KLocalizedString>
 #include <QPushButton>
 #include <KStandardGuiItem>
 
+#include <QAbstractListModel>
+#include <QBrush>
+#include <QComboBox>
+#include <QHash>
 #include <QLabel>
+#include <QListView>
+#include <QPointer>
+#include <QSet>
+#include <QSortFilterProxyModel>
+#include <QStyledItemDelegate>
+#include <QTextDocumentFragment>
 #include <QVBoxLayout>
 
 #include <KGuiItem>
 
+#include <algorithm>
+
 using namespace Kleo;
 using namespace Kleo::Crypto;
 using namespace Kleo::Crypto::Gui;
 
+namespace
+{
+
+static bool hasBadSignature(const Task::Result &result)
+{
+    const auto dvResult = dynamic_cast<const DecryptVerifyResult *>(&result);
+    if (!dvResult) {
+        return false;
+    }
+    const std::vector<GpgME::Signature> sigs = dvResult->verificationResult().signatures();
+    return std::any_of(sigs.cbegin(), sigs.cend(), [](const GpgME::Signature &sig) {
+        return sig.summary() & GpgME::Signature::Red;
+    });
+}
+
+// Keeps the results of all tasks, errors first. Per row only the result and
+// a plain text version of its overview are kept; the widgets showing the
+// details and the actions of a result are created on demand.
+class ResultListModel : public QAbstractListModel
+{
+public:
+    enum Role {
+        HasErrorRole = Qt::UserRole,
+        BadSignatureRole
+    };
+
+    explicit ResultListModel(QObject *parent = nullptr)
+        : QAbstractListModel(parent), m_numErrors(0)
+    {
+    }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : static_cast<int>(m_items.size());
+    }
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override
+    {
+        if (!index.isValid() || index.row() >= rowCount()) {
+            return QVariant();
+        }
+        const Item &item = m_items[index.row()];
+        switch (role) {
+        case Qt::DisplayRole:
+        case Qt::AccessibleTextRole:
+            return item.overview;
+        case Qt::ToolTipRole:
+            return item.result->details();
+        case Qt::BackgroundRole:
+            return brushes(item.result->code()).first;
+        case Qt::ForegroundRole:
+            return brushes(item.result->code()).second;
+        case HasErrorRole:
+            return item.result->hasError();
+        case BadSignatureRole:
+            return item.badSignature;
+        }
+        return QVariant();
+    }
+
+    std::shared_ptr<const Task::Result> result(const QModelIndex &index) const
+    {
+        if (!index.isValid() || index.row() >= rowCount()) {
+            return std::shared_ptr<const Task::Result>();
+        }
+        return m_items[index.row()].result;
+    }
+
+    QModelIndex addResult(const std::shared_ptr<const Task::Result> &result)
+    {
+        Q_ASSERT(result);
+        // a task which is restarted (e.g. after importing a missing key)
+        // delivers a new result that replaces the previous one
+        const QPointer<Task> task = result->parentTask();
+        if (task) {
+            if (m_tasks.contains(task.data())) {
+                removeResultOf(task.data());
+            } else {
+                m_tasks.insert(task.data());
+            }
+        }
+
+        const QString overview = QTextDocumentFragment::fromHtml(result->overview()).toPlainText().simplified();
+        const bool error = result->hasError();
+        const int row = error ? m_numErrors : rowCount();
+        beginInsertRows(QModelIndex(), row, row);
+        m_items.insert(m_items.begin() + row, Item{result, overview, hasBadSignature(*result)});
+        if (error) {
+            ++m_numErrors;
+        }
+        endInsertRows();
+        return index(row, 0);
+    }
+
+private:
+    void removeResultOf(const Task *task)
+    {
+        const auto it = std::find_if(m_items.cbegin(), m_items.cend(), [task](const Item &item) {
+            return item.result->parentTask().data() == task;
+        });
+        if (it == m_items.cend()) {
+            return;
+        }
+        const int row = std::distance(m_items.cbegin(), it);
+        beginRemoveRows(QModelIndex(), row, row);
+        if (row < m_numErrors) {
+            --m_numErrors;
+        }
+        m_items.erase(it);
+        endRemoveRows();
+    }
+
+    const QPair<QBrush, QBrush> &brushes(Task::Result::VisualCode code) const
+    {
+        auto it = m_brushes.find(code);
+        if (it == m_brushes.end()) {
+            it = m_brushes.insert(code, qMakePair(QBrush(colorForVisualCode(code)),
+                                                  QBrush(txtColorForVisualCode(code))));
+        }
+        return it.value();
+    }
+
+    struct Item {
+        std::shared_ptr<const Task::Result> result;
+        QString overview;
+        bool badSignature;
+    };
+
+    std::vector<Item> m_items;
+    int m_numErrors;
+    QSet<const Task *> m_tasks;
+    mutable QHash<int, QPair<QBrush, QBrush>> m_brushes;
+};
+
+class ResultFilterModel : public QSortFilterProxyModel
+{
+public:
+    enum Filter {
+        AllResults,
+        ErrorsOnly,
+        BadSignaturesOnly
+    };
+
+    explicit ResultFilterModel(QObject *parent = nullptr)
+        : QSortFilterProxyModel(parent), m_filter(AllResults)
+    {
+    }
+
+    void setFilter(Filter filter)
+    {
+        if (filter == m_filter) {
+            return;
+        }
+        m_filter = filter;
+        invalidateFilter();
+    }
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override
+    {
+        switch (m_filter) {
+        case ErrorsOnly:
+            return sourceModel()->index(sourceRow, 0, sourceParent).data(ResultListModel::HasErrorRole).toBool();
+        case BadSignaturesOnly:
+            return sourceModel()->index(sourceRow, 0, sourceParent).data(ResultListModel::BadSignatureRole).toBool();
+        case AllResults:
+        default:
+            return true;
+        }
+    }
+
+private:
+    Filter m_filter;
+};
+
+// Shows the overview of a result on a single, elided line, so that all rows
+// have the same height and the view only ever lays out the visible rows.
+class ResultItemDelegate : public QStyledItemDelegate
+{
+public:
+    using QStyledItemDelegate::QStyledItemDelegate;
+
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        QSize size = QStyledItemDelegate::sizeHint(option, index);
+        size.setHeight(option.fontMetrics.height() + 2 * RowPadding);
+        return size;
+    }
+
+protected:
+    void initStyleOption(QStyleOptionViewItem *option, const QModelIndex &index) const override
+    {
+        QStyledItemDelegate::initStyleOption(option, index);
+        option->features &= ~QStyleOptionViewItem::WrapText;
+        option->textElideMode = Qt::ElideRight;
+    }
+
+private:
+    enum { RowPadding = 4 };
+};
+
+}
+
 class ResultListWidget::Private
 {
     ResultListWidget *const q;
@@ -66,15 +284,21 @@ public:
     void started(const std::shared_ptr<Task> &task);
     void allTasksDone();
 
-    void addResultWidget(ResultItemWidget *widget);
+    void showDetails(const QModelIndex &index);
+    void ensureCurrentResult();
     void setupSingle();
     void setupMulti();
     void resizeIfStandalone();
 
     std::vector< std::shared_ptr<TaskCollection> > m_collections;
     bool m_standaloneMode;
-    int m_lastErrorItemIndex;
+    ResultListModel *m_model;
+    ResultFilterModel *m_filterModel;
+    QComboBox *m_filterCombo;
+    QListView *m_view;
     ScrollArea *m_scrollArea;
+    ResultItemWidget *m_detailsWidget;
+    std::shared_ptr<const Task::Result> m_detailsResult;
     QPushButton *m_closeButton;
     QVBoxLayout *m_layout;
     QLabel *m_progressLabel;
@@ -84,12 +308,18 @@ ResultListWidget::Private::Private(ResultListWidget *qq)
     : q(qq),
       m_collections(),
       m_standaloneMode(false),
-      m_lastErrorItemIndex(0),
+      m_model(new ResultListModel(qq)),
+      m_filterModel(new ResultFilterModel(qq)),
+      m_filterCombo(nullptr),
+      m_view(nullptr),
       m_scrollArea(nullptr),
+      m_detailsWidget(nullptr),
       m_closeButton(nullptr),
       m_layout(nullptr),
       m_progressLabel(nullptr)
 {
+    m_filterModel->setSourceModel(m_model);
+
     m_layout = new QVBoxLayout(q);
     m_layout->setContentsMargins(0, 0, 0, 0);
     m_layout->setSpacing(0);
@@ -137,31 +367,76 @@ void ResultListWidget::Private::setupMulti()
         return;    // already been here...
     }
 
+    // the filter and the list are only shown once there is more than one result
+    m_filterCombo = new QComboBox;
+    m_filterCombo->addItem(i18n("All results"), ResultFilterModel::AllResults);
+    m_filterCombo->addItem(i18n("Errors only"), ResultFilterModel::ErrorsOnly);
+    m_filterCombo->addItem(i18n("Bad signatures only"), ResultFilterModel::BadSignaturesOnly);
+    m_filterCombo->setVisible(false);
+    q->connect(m_filterCombo, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+               q, [this]() {
+        m_filterModel->setFilter(static_cast<ResultFilterModel::Filter>(m_filterCombo->currentData().toInt()));
+        ensureCurrentResult();
+    });
+
+    m_view = new QListView;
+    m_view->setUniformItemSizes(true);
+    m_view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_view->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_view->setItemDelegate(new ResultItemDelegate(m_view));
+    m_view->setModel(m_filterModel);
+    m_view->setVisible(false);
+    q->connect(m_view->selectionModel(), &QItemSelectionModel::currentChanged,
+               q, [this](const QModelIndex &current) {
+        showDetails(current);
+    });
+
     m_scrollArea = new ScrollArea;
     m_scrollArea->setFocusPolicy(Qt::NoFocus);
     Q_ASSERT(qobject_cast<QBoxLayout *>(m_scrollArea->widget()->layout()));
     static_cast<QBoxLayout *>(m_scrollArea->widget()->layout())->setContentsMargins(0, 0, 0, 0);
     static_cast<QBoxLayout *>(m_scrollArea->widget()->layout())->setSpacing(2);
     static_cast<QBoxLayout *>(m_scrollArea->widget()->layout())->addStretch();
-    m_layout->insertWidget(0, m_scrollArea);
+
+    m_layout->insertWidget(0, m_filterCombo);
+    m_layout->insertWidget(1, m_view, 1);
+    m_layout->insertWidget(2, m_scrollArea, 1);
 }
 
-void ResultListWidget::Private::addResultWidget(ResultItemWidget *widget)
+void ResultListWidget::Private::showDetails(const QModelIndex &index)
 {
-    Q_ASSERT(widget);
-    Q_ASSERT(std::any_of(m_collections.cbegin(), m_collections.cend(),
-                       [](const std::shared_ptr<TaskCollection> &t) { return !t->isEmpty(); }));
+    const auto result = m_model->result(m_filterModel->mapToSource(index));
+    if (result == m_detailsResult) {
+        return;
+    }
+    if (m_detailsWidget) {
+        // the widget may be the sender of the signal that got us here
+        m_detailsWidget->hide();
+        m_detailsWidget->deleteLater();
+        m_detailsWidget = nullptr;
+    }
+    m_detailsResult = result;
+    if (!result) {
+        return;
+    }
 
-    Q_ASSERT(m_scrollArea);
-    Q_ASSERT(m_scrollArea->widget());
-    Q_ASSERT(qobject_cast<QBoxLayout *>(m_scrollArea->widget()->layout()));
-    QBoxLayout &blay = *static_cast<QBoxLayout *>(m_scrollArea->widget()->layout());
-    blay.insertWidget(widget->hasErrorResult() ? m_lastErrorItemIndex++ : (blay.count() - 1), widget);
+    m_detailsWidget = new ResultItemWidget(result);
+    q->connect(m_detailsWidget, &ResultItemWidget::linkActivated, q, &ResultListWidget::linkActivated);
+    q->connect(m_detailsWidget, &ResultItemWidget::closeButtonClicked, q, &ResultListWidget::close);
 
-    widget->show();
+    Q_ASSERT(qobject_cast<QBoxLayout *>(m_scrollArea->widget()->layout()));
+    static_cast<QBoxLayout *>(m_scrollArea->widget()->layout())->insertWidget(0, m_detailsWidget);
+    m_detailsWidget->show();
     resizeIfStandalone();
 }
 
+void ResultListWidget::Private::ensureCurrentResult()
+{
+    if (!m_view->currentIndex().isValid() && m_filterModel->rowCount() > 0) {
+        m_view->setCurrentIndex(m_filterModel->index(0, 0));
+    }
+}
+
 void ResultListWidget::Private::allTasksDone()
 {
     if (!q->isComplete()) {
@@ -177,10 +452,21 @@ void ResultListWidget::Private::result(const std::shared_ptr<const Task::Result>
     Q_ASSERT(result);
     Q_ASSERT(std::any_of(m_collections.cbegin(), m_collections.cend(),
                        [](const std::shared_ptr<TaskCollection> &t) { return !t->isEmpty(); }));
-    ResultItemWidget *wid = new ResultItemWidget(result);
-    q->connect(wid, &ResultItemWidget::linkActivated, q, &ResultListWidget::linkActivated);
-    q->connect(wid, &ResultItemWidget::closeButtonClicked, q, &ResultListWidget::close);
-    addResultWidget(wid);
+    Q_ASSERT(m_view);
+
+    const bool replacesDetails = m_detailsResult && result->parentTask()
+                                 && m_detailsResult->parentTask() == result->parentTask();
+    const QModelIndex index = m_filterModel->mapFromSource(m_model->addResult(result));
+    if (replacesDetails && index.isValid()) {
+        m_view->setCurrentIndex(index);
+    }
+
+    if (m_model->rowCount() == 2) {
+        m_filterCombo->setVisible(true);
+        m_view->setVisible(true);
+        resizeIfStandalone();
+    }
+    ensureCurrentResult();
 }
 
 bool ResultListWidget::isComplete() const
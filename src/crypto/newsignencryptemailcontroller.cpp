@@ -39,6 +39,7 @@
 #include "taskcollection.h"
 #include "sender.h"
 #include "recipient.h"
+#include "recipientresolutioncache.h"
 
 #include "emailoperationspreferences.h"
 
@@ -234,14 +235,9 @@ static std::vector<Sender> mailbox2sender(const std::vector<Mailbox> &mbs)
     return senders;
 }
 
-static std::vector<Recipient> mailbox2recipient(const std::vector<Mailbox> &mbs)
+static std::vector<Recipient> mailbox2recipient(const std::vector<Mailbox> &mbs, Protocol proto)
 {
-    std::vector<Recipient> recipients;
-    recipients.reserve(mbs.size());
-    for (const Mailbox &mb : mbs) {
-        recipients.push_back(Recipient(mb));
-    }
-    return recipients;
+    return RecipientResolutionCache::instance()->recipients(mbs, proto);
 }
 
 class NewSignEncryptEMailController::Private
@@ -405,7 +401,7 @@ void NewSignEncryptEMailController::startResolveCertificates(const std::vector<M
     d->resolvingInProgress = true;
 
     const std::vector<Sender> senders = mailbox2sender(s);
-    const std::vector<Recipient> recipients = mailbox2recipient(r);
+    const std::vector<Recipient> recipients = mailbox2recipient(r, d->presetProtocol);
     const bool quickMode = is_dialog_quick_mode(d->sign, d->encrypt);
 
     const bool conflict = quickMode && has_conflict(d->sign, d->encrypt, senders, recipients, d->presetProtocol);
@@ -0,0 +1,176 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    crypto/recipientresolutioncache.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+#include <config-kleopatra.h>
+
+#include "recipientresolutioncache.h"
+
+#include "recipient.h"
+
+#include "kleopatra_debug.h"
+
+#include <Libkleo/KeyCache>
+
+#include <kmime/kmime_header_parsing.h>
+
+#include <QString>
+
+#include <algorithm>
+#include <map>
+
+using namespace Kleo;
+using namespace Kleo::Crypto;
+using namespace KMime::Types;
+
+static const unsigned int MAX_CACHED_RECIPIENT_SETS = 64;
+
+namespace
+{
+struct CacheKey {
+    GpgME::Protocol protocol;
+    std::vector<QString> mailboxes; // sorted
+    unsigned int generation;
+
+    bool operator<(const CacheKey &other) const
+    {
+        if (generation != other.generation) {
+            return generation < other.generation;
+        }
+        if (protocol != other.protocol) {
+            return protocol < other.protocol;
+        }
+        return mailboxes < other.mailboxes;
+    }
+};
+
+struct CacheEntry {
+    // parallel to CacheKey::mailboxes
+    std::vector<Recipient> recipients;
+    unsigned long lastUse;
+};
+}
+
+class RecipientResolutionCache::Private
+{
+    friend class ::Kleo::Crypto::RecipientResolutionCache;
+public:
+    Private()
+        : entries(),
+          generation(0),
+          useCounter(0)
+    {
+    }
+
+private:
+    void evictIfNeeded();
+
+private:
+    std::map<CacheKey, CacheEntry> entries;
+    unsigned int generation;
+    unsigned long useCounter;
+};
+
+void RecipientResolutionCache::Private::evictIfNeeded()
+{
+    while (entries.size() > MAX_CACHED_RECIPIENT_SETS) {
+        const auto oldest = std::min_element(entries.begin(), entries.end(),
+                                             [](const std::pair<const CacheKey, CacheEntry> &lhs,
+                                                const std::pair<const CacheKey, CacheEntry> &rhs) {
+                                                 return lhs.second.lastUse < rhs.second.lastUse;
+                                             });
+        entries.erase(oldest);
+    }
+}
+
+// static
+RecipientResolutionCache *RecipientResolutionCache::instance()
+{
+    static RecipientResolutionCache cache;
+    return &cache;
+}
+
+RecipientResolutionCache::RecipientResolutionCache()
+    : QObject(), d(new Private)
+{
+    connect(KeyCache::instance().get(), &KeyCache::keysMayHaveChanged,
+            this, &RecipientResolutionCache::clear);
+}
+
+RecipientResolutionCache::~RecipientResolutionCache() {}
+
+unsigned int RecipientResolutionCache::generation() const
+{
+    return d->generation;
+}
+
+void RecipientResolutionCache::clear()
+{
+    ++d->generation;
+    d->entries.clear();
+}
+
+std::vector<Recipient> RecipientResolutionCache::recipients(const std::vector<Mailbox> &mbs, GpgME::Protocol proto)
+{
+    CacheKey key = { proto, std::vector<QString>(), d->generation };
+    key.mailboxes.reserve(mbs.size());
+    for (const Mailbox &mb : mbs) {
+        key.mailboxes.push_back(mb.prettyAddress());
+    }
+    std::vector<QString> requested = key.mailboxes;
+    std::sort(key.mailboxes.begin(), key.mailboxes.end());
+    key.mailboxes.erase(std::unique(key.mailboxes.begin(), key.mailboxes.end()), key.mailboxes.end());
+
+    auto it = d->entries.find(key);
+    if (it == d->entries.end()) {
+        CacheEntry entry = { std::vector<Recipient>(key.mailboxes.size()), ++d->useCounter };
+        for (const Mailbox &mb : mbs) {
+            const auto pos = std::lower_bound(key.mailboxes.cbegin(), key.mailboxes.cend(), mb.prettyAddress());
+            Recipient &r = entry.recipients[pos - key.mailboxes.cbegin()];
+            if (r.isNull()) {
+                r = Recipient(mb);
+            }
+        }
+        it = d->entries.insert(std::make_pair(std::move(key), std::move(entry))).first;
+        d->evictIfNeeded(); // never evicts the entry just inserted, it is the most recently used
+    } else {
+        qCDebug(KLEOPATRA_LOG) << "serving" << requested.size() << "recipients from cache";
+        it->second.lastUse = ++d->useCounter;
+    }
+
+    std::vector<Recipient> result;
+    result.reserve(requested.size());
+    for (const QString &address : requested) {
+        const auto pos = std::lower_bound(it->first.mailboxes.cbegin(), it->first.mailboxes.cend(), address);
+        result.push_back(it->second.recipients[pos - it->first.mailboxes.cbegin()]);
+    }
+    return result;
+}
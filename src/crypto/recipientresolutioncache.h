@@ -0,0 +1,100 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    crypto/recipientresolutioncache.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+#ifndef __KLEOPATRA_CRYPTO_RECIPIENTRESOLUTIONCACHE_H__
+#define __KLEOPATRA_CRYPTO_RECIPIENTRESOLUTIONCACHE_H__
+
+#include <QObject>
+
+#include <utils/pimpl_ptr.h>
+
+#include <gpgme++/global.h>
+
+#include <vector>
+
+namespace KMime
+{
+namespace Types
+{
+class Mailbox;
+}
+}
+
+namespace Kleo
+{
+namespace Crypto
+{
+
+class Recipient;
+
+/*!
+  \brief Caches the certificate candidates of recipient sets
+
+  Mail clients tend to send PREP_ENCRYPT for the same (often large)
+  set of recipients over and over again. RecipientResolutionCache
+  remembers the Recipient objects created for a set of mailboxes,
+  keyed by protocol, the sorted set of mailboxes and the key cache
+  generation, so that repeated requests do not look up every mailbox
+  in the KeyCache again.
+
+  The cache is shared by all UiServer connections. It is flushed
+  whenever KeyCache::keysMayHaveChanged() is emitted.
+*/
+class RecipientResolutionCache : public QObject
+{
+    Q_OBJECT
+public:
+    static RecipientResolutionCache *instance();
+    ~RecipientResolutionCache() override;
+
+    /*!
+      Returns a Recipient for each of \a mailboxes, in the order
+      given. Results are served from the cache when possible.
+    */
+    std::vector<Recipient> recipients(const std::vector<KMime::Types::Mailbox> &mailboxes, GpgME::Protocol proto);
+
+    unsigned int generation() const;
+
+public Q_SLOTS:
+    void clear();
+
+private:
+    RecipientResolutionCache();
+
+    class Private;
+    kdtools::pimpl_ptr<Private> d;
+};
+
+}
+}
+
+#endif /* __KLEOPATRA_CRYPTO_RECIPIENTRESOLUTIONCACHE_H__ */
@@ -63,6 +63,8 @@
 #include <QFileInfo>
 #include <QDir>
 
+#include <algorithm>
+
 using namespace Kleo;
 using namespace Kleo::Crypto;
 using namespace GpgME;
@@ -93,12 +95,12 @@ private:
 
     void schedule();
     std::shared_ptr<SignEncryptTask> takeRunnable(GpgME::Protocol proto);
+    unsigned int numRunning(GpgME::Protocol proto) const;
 
     static void assertValidOperation(unsigned int);
     static QString titleForOperation(unsigned int op);
 private:
-    std::vector< std::shared_ptr<SignEncryptTask> > runnable, completed;
-    std::shared_ptr<SignEncryptTask> cms, openpgp;
+    std::vector< std::shared_ptr<SignEncryptTask> > runnable, running, completed;
     QPointer<SignEncryptFilesWizard> wizard;
     QStringList files;
     unsigned int operation;
@@ -108,8 +110,7 @@ private:
 SignEncryptFilesController::Private::Private(SignEncryptFilesController *qq)
     : q(qq),
       runnable(),
-      cms(),
-      openpgp(),
+      running(),
       wizard(),
       files(),
       operation(SignAllowed | EncryptAllowed | ArchiveAllowed),
@@ -620,24 +621,28 @@ void SignEncryptFilesController::Private::slotWizardOperationPrepared()
 void SignEncryptFilesController::Private::schedule()
 {
 
-    if (!cms)
-        if (const std::shared_ptr<SignEncryptTask> t = takeRunnable(CMS)) {
-            t->start();
-            cms = t;
-        }
-
-    if (!openpgp)
-        if (const std::shared_ptr<SignEncryptTask> t = takeRunnable(OpenPGP)) {
-            t->start();
-            openpgp = t;
-        }
+    for (const Protocol proto : { CMS, OpenPGP }) {
+        while (numRunning(proto) < q->maximumConcurrentTasks())
+            if (const std::shared_ptr<SignEncryptTask> t = takeRunnable(proto)) {
+                running.push_back(t);
+                t->start();
+            } else {
+                break;
+            }
+    }
 
-    if (!cms && !openpgp) {
+    if (running.empty()) {
         kleo_assert(runnable.empty());
         q->emitDoneOrError();
     }
 }
 
+unsigned int SignEncryptFilesController::Private::numRunning(GpgME::Protocol proto) const
+{
+    return std::count_if(running.cbegin(), running.cend(),
+                         [proto](const std::shared_ptr<SignEncryptTask> &task) { return task->protocol() == proto; });
+}
+
 std::shared_ptr<SignEncryptTask> SignEncryptFilesController::Private::takeRunnable(GpgME::Protocol proto)
 {
     const auto it = std::find_if(runnable.begin(), runnable.end(),
@@ -661,12 +666,11 @@ void SignEncryptFilesController::doTaskDone(const Task *task, const std::shared_
     // might not yet have executed. Therefore, we push completed tasks
     // into a burial container
 
-    if (task == d->cms.get()) {
-        d->completed.push_back(d->cms);
-        d->cms.reset();
-    } else if (task == d->openpgp.get()) {
-        d->completed.push_back(d->openpgp);
-        d->openpgp.reset();
+    const auto it = std::find_if(d->running.begin(), d->running.end(),
+                                 [task](const std::shared_ptr<SignEncryptTask> &t) { return t.get() == task; });
+    if (it != d->running.end()) {
+        d->completed.push_back(*it);
+        d->running.erase(it);
     }
 
     QTimer::singleShot(0, this, SLOT(schedule()));
@@ -692,12 +696,11 @@ void SignEncryptFilesController::Private::cancelAllTasks()
     // signal emissions.
     runnable.clear();
 
-    // a cancel() will result in a call to
-    if (cms) {
-        cms->cancel();
-    }
-    if (openpgp) {
-        openpgp->cancel();
+    // cancel() results in a call to doTaskDone(), which modifies
+    // running, so iterate over a copy:
+    const std::vector< std::shared_ptr<SignEncryptTask> > tasks = running;
+    for (const std::shared_ptr<SignEncryptTask> &t : tasks) {
+        t->cancel();
     }
 }
 
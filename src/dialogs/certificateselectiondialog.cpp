@@ -37,6 +37,8 @@
 #include <view/searchbar.h>
 #include <view/tabwidget.h>
 
+#include <utils/itemselection.h>
+
 #include <Libkleo/KeyListModel>
 #include <Libkleo/KeyCache>
 
@@ -258,10 +260,7 @@ void CertificateSelectionDialog::selectCertificates(const std::vector<Key> &keys
     QItemSelectionModel *const sm = view->selectionModel();
     Q_ASSERT(sm);
 
-    Q_FOREACH (const QModelIndex &idx, model->indexes(keys))
-        if (idx.isValid()) {
-            sm->select(idx, QItemSelectionModel::Select | QItemSelectionModel::Rows);
-        }
+    sm->select(rowSelectionFromIndexes(model->indexes(keys)), QItemSelectionModel::Select | QItemSelectionModel::Rows);
 }
 
 void CertificateSelectionDialog::selectCertificate(const Key &key)
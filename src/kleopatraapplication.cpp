@@ -45,10 +45,12 @@
 #include <utils/gnupg-helper.h>
 #include <utils/kdpipeiodevice.h>
 #include <utils/log.h>
+#include <utils/keycachesnapshot.h>
+#include <utils/keyringwatcher.h>
 
 #include <gpgme++/key.h>
+#include <gpgme++/keylistresult.h>
 
-#include <Libkleo/FileSystemWatcher>
 #include <Libkleo/KeyCache>
 #include <Libkleo/Classify>
 
@@ -152,18 +154,21 @@ public:
 #endif
     std::shared_ptr<KeyCache> keyCache;
     std::shared_ptr<Log> log;
-    std::shared_ptr<FileSystemWatcher> watcher;
+    std::shared_ptr<KeyRingWatcher> keyRingWatcher;
 
 public:
     void setupKeyCache()
     {
         keyCache = KeyCache::mutableInstance();
-        watcher.reset(new FileSystemWatcher);
+        // reloads changed keys, or all of them on external modifications:
+        keyRingWatcher = KeyRingWatcher::mutableInstance();
 
-        watcher->whitelistFiles(gnupgFileWhitelist());
-        watcher->addPath(gnupgHomeDirectory());
-        watcher->setDelay(1000);
-        keyCache->addFileSystemWatcher(watcher);
+        // keep a snapshot of each complete listing, for the next start
+        QObject::connect(keyCache.get(), &KeyCache::keyListingDone, q, [](const GpgME::KeyListResult &result) {
+            if (!result.error()) {
+                KeyCacheSnapshot::write(KeyCache::instance()->keys());
+            }
+        });
     }
 
     void setupLogging()
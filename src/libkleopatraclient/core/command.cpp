@@ -23,6 +23,7 @@
 
 #include "command.h"
 #include "command_p.h"
+#include "commandexecutor.h"
 
 #include <QtGlobal> // Q_OS_WIN
 
@@ -35,8 +36,16 @@
 # include <windows.h>
 #endif
 
+#ifdef Q_OS_LINUX
+# include <sys/inotify.h>
+# include <poll.h>
+# include <unistd.h>
+#endif
+
 #include <QMutexLocker>
 #include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
 #include "libkleopatraclientcore_debug.h"
 #include <QDir>
 #include <QProcess>
@@ -46,11 +55,14 @@
 #include <gpg-error.h>
 
 #include <algorithm>
+#include <vector>
 #include <string>
 #include <sstream>
 #include <memory>
 #include <type_traits>
 
+#include <climits>
+
 using namespace KleopatraClientCopy;
 
 // copied from kleopatra/utils/hex.cpp
@@ -158,12 +170,12 @@ QString Command::serverLocation() const
 
 bool Command::waitForFinished()
 {
-    return d->wait();
+    return d->waitForPooled(ULONG_MAX) && d->wait();
 }
 
 bool Command::waitForFinished(unsigned long ms)
 {
-    return d->wait(ms);
+    return d->waitForPooled(ms) && d->wait(ms);
 }
 
 bool Command::error() const
@@ -559,79 +571,116 @@ static assuan_error_t send_sender(const AssuanClientContext &ctx, const QString
     return my_assuan_transact(ctx, ss.str().c_str());
 }
 
-void Command::Private::run()
-{
+static const unsigned int UISERVER_STARTUP_TIMEOUT = 10000; // ms
 
-    // Take a snapshot of the input data, and clear the output data:
-    Inputs in;
-    Outputs out;
+namespace
+{
+// Lets a thread sleep until something happens in the directory of the
+// UI server socket (using inotify on Linux), or a timeout expires.
+class SocketWatcher
+{
+public:
+    explicit SocketWatcher(const QString &socketName)
+        : fd(-1)
     {
-        const QMutexLocker locker(&mutex);
-        in = inputs;
-        outputs = out;
+#ifdef Q_OS_LINUX
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd >= 0 && inotify_add_watch(fd, QFile::encodeName(QFileInfo(socketName).absolutePath()).constData(),
+                                         IN_CREATE | IN_MOVED_TO | IN_ATTRIB) < 0) {
+            ::close(fd);
+            fd = -1;
+        }
+#else
+        Q_UNUSED(socketName);
+#endif
     }
-
-    out.canceled = false;
-
-    if (out.serverLocation.isEmpty()) {
-        out.serverLocation = default_socket_name();
+    ~SocketWatcher()
+    {
+#ifdef Q_OS_LINUX
+        if (fd >= 0) {
+            ::close(fd);
+        }
+#endif
     }
 
-#ifndef HAVE_ASSUAN2
-    assuan_context_t naked_ctx = 0;
+    void wait(unsigned int ms)
+    {
+#ifdef Q_OS_LINUX
+        if (fd >= 0) {
+            pollfd pfd = { fd, POLLIN, 0 };
+            if (::poll(&pfd, 1, static_cast<int>(ms)) > 0) {
+                char buffer[4096];
+                while (::read(fd, buffer, sizeof buffer) > 0) {
+                    ;
+                }
+            }
+            return;
+        }
 #endif
-    AssuanClientContext ctx;
-    assuan_error_t err = 0;
+        QThread::msleep(ms);
+    }
 
-    inquire_data id = { &in.inquireData, &ctx };
+private:
+    Q_DISABLE_COPY(SocketWatcher)
+    int fd;
+};
+}
 
-    const QString socketName = out.serverLocation;
+// Connects ctx to the UI server listening on socketName, starting the
+// server if necessary, and queries its pid. Returns an error string,
+// or a null QString on success.
+static QString connect_to_uiserver(AssuanClientContext &ctx, const QString &socketName, qint64 &serverPid)
+{
     if (socketName.isEmpty()) {
-        out.errorString = i18n("Invalid socket name!");
-        goto leave;
+        return i18n("Invalid socket name!");
     }
 
 #ifndef HAVE_ASSUAN2
-    err = assuan_socket_connect(&naked_ctx, QFile::encodeName(socketName).constData(), -1);
+    assuan_context_t naked_ctx = 0;
+    assuan_error_t err = assuan_socket_connect(&naked_ctx, QFile::encodeName(socketName).constData(), -1);
 #else
     {
         assuan_context_t naked_ctx = nullptr;
-        err = assuan_new(&naked_ctx);
+        const assuan_error_t err = assuan_new(&naked_ctx);
         if (err) {
-            out.errorString = i18n("Could not allocate resources to connect to Kleopatra UI server at %1: %2"
-                                   , socketName, to_error_string(err));
-            goto leave;
+            return i18n("Could not allocate resources to connect to Kleopatra UI server at %1: %2"
+                        , socketName, to_error_string(err));
         }
 
         ctx.reset(naked_ctx);
     }
 
-    err = assuan_socket_connect(ctx.get(), QFile::encodeName(socketName).constData(), -1, 0);
+    assuan_error_t err = assuan_socket_connect(ctx.get(), QFile::encodeName(socketName).constData(), -1, 0);
 #endif
     if (err) {
         qDebug("UI server not running, starting it");
 
         const QString errorString = start_uiserver();
         if (!errorString.isEmpty()) {
-            out.errorString = errorString;
-            goto leave;
+            return errorString;
         }
 
-        // give it a bit of time to start up and try a couple of times
-        for (int i = 0; err && i < 20; ++i) {
-            msleep(500);
+        // retry as soon as the socket shows up, backing off in case it
+        // exists but isn't listening yet (or we can't watch for it)
+        SocketWatcher watcher(socketName);
+        QElapsedTimer timer;
+        timer.start();
+        for (unsigned int interval = 5; err && !timer.hasExpired(UISERVER_STARTUP_TIMEOUT); interval = qMin(2 * interval, 250U)) {
+            watcher.wait(interval);
 #ifndef HAVE_ASSUAN2
             err = assuan_socket_connect(&naked_ctx, QFile::encodeName(socketName).constData(), -1);
 #else
             err = assuan_socket_connect(ctx.get(), QFile::encodeName(socketName).constData(), -1, 0);
 #endif
         }
+        if (!err) {
+            qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "UI server ready after" << timer.elapsed() << "ms";
+        }
     }
 
     if (err) {
-        out.errorString = i18n("Could not connect to Kleopatra UI server at %1: %2",
-                               socketName, to_error_string(err));
-        goto leave;
+        return i18n("Could not connect to Kleopatra UI server at %1: %2",
+                    socketName, to_error_string(err));
     }
 
 #ifndef HAVE_ASSUAN2
@@ -639,24 +688,35 @@ void Command::Private::run()
     naked_ctx = 0;
 #endif
 
-    out.serverPid = -1;
-    err = my_assuan_transact(ctx, "GETINFO pid", &getinfo_pid_cb, &out.serverPid);
-    if (err || out.serverPid <= 0) {
-        out.errorString = i18n("Could not get the process-id of the Kleopatra UI server at %1: %2", socketName, to_error_string(err));
-        goto leave;
+    serverPid = -1;
+    err = my_assuan_transact(ctx, "GETINFO pid", &getinfo_pid_cb, &serverPid);
+    if (err || serverPid <= 0) {
+        return i18n("Could not get the process-id of the Kleopatra UI server at %1: %2", socketName, to_error_string(err));
     }
 
-    qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "Server PID =" << out.serverPid;
+    qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "Server PID =" << serverPid;
+
+    return QString();
+}
 
+static void allow_set_foreground_window(qint64 serverPid)
+{
 #if defined(Q_OS_WIN)
-    if (!AllowSetForegroundWindow((pid_t)out.serverPid)) {
-        qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "AllowSetForegroundWindow(" << out.serverPid << ") failed: " << GetLastError();
+    if (!AllowSetForegroundWindow((pid_t)serverPid)) {
+        qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "AllowSetForegroundWindow(" << serverPid << ") failed: " << GetLastError();
     }
+#else
+    Q_UNUSED(serverPid);
 #endif
+}
 
-    if (in.command.isEmpty()) {
-        goto leave;
-    }
+// Sends the options, files, senders and recipients from in over ctx,
+// then runs in.command. Errors are reported in out.
+static assuan_error_t send_command(const AssuanClientContext &ctx, const Command::Private::Inputs &in, Command::Private::Outputs &out)
+{
+    assuan_error_t err = 0;
+
+    inquire_data id = { &in.inquireData, &ctx };
 
     if (in.parentWId) {
 #if defined(Q_OS_WIN32)
@@ -669,11 +729,11 @@ void Command::Private::run()
         }
     }
 
-    for (std::map<std::string, Option>::const_iterator it = in.options.begin(), end = in.options.end(); it != end; ++it)
+    for (std::map<std::string, Command::Private::Option>::const_iterator it = in.options.begin(), end = in.options.end(); it != end; ++it)
         if ((err = send_option(ctx, it->first.c_str(), it->second.hasValue ? it->second.value.toString() : QVariant()))) {
             if (it->second.isCritical) {
                 out.errorString = i18n("Failed to send critical option %1: %2", QString::fromLatin1(it->first.c_str()), to_error_string(err));
-                goto leave;
+                return err;
             } else {
                 qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "Failed to send non-critical option" << it->first.c_str() << ":" << to_error_string(err);
             }
@@ -682,19 +742,19 @@ void Command::Private::run()
     Q_FOREACH (const QString &filePath, in.filePaths)
         if ((err = send_file(ctx, filePath))) {
             out.errorString = i18n("Failed to send file path %1: %2", filePath, to_error_string(err));
-            goto leave;
+            return err;
         }
 
     Q_FOREACH (const QString &sender, in.senders)
         if ((err = send_sender(ctx, sender, in.areSendersInformative))) {
             out.errorString = i18n("Failed to send sender %1: %2", sender, to_error_string(err));
-            goto leave;
+            return err;
         }
 
     Q_FOREACH (const QString &recipient, in.recipients)
         if ((err = send_recipient(ctx, recipient, in.areRecipientsInformative))) {
             out.errorString = i18n("Failed to send recipient %1: %2", recipient, to_error_string(err));
-            goto leave;
+            return err;
         }
 
 #if 0
@@ -708,11 +768,183 @@ void Command::Private::run()
         } else {
             out.errorString = i18n("Command (%1) failed: %2", QString::fromLatin1(in.command.constData()), to_error_string(err));
         }
-        goto leave;
+    }
+    return err;
+}
+
+void Command::Private::run()
+{
+
+    // Take a snapshot of the input data, and clear the output data:
+    Inputs in;
+    Outputs out;
+    {
+        const QMutexLocker locker(&mutex);
+        in = inputs;
+        outputs = out;
+    }
+
+    out.canceled = false;
+
+    if (out.serverLocation.isEmpty()) {
+        out.serverLocation = default_socket_name();
+    }
+
+    AssuanClientContext ctx;
+
+    out.errorString = connect_to_uiserver(ctx, out.serverLocation, out.serverPid);
+    if (out.errorString.isEmpty()) {
+        allow_set_foreground_window(out.serverPid);
+        if (!in.command.isEmpty()) {
+            send_command(ctx, in, out);
+        }
     }
 
-leave:
     const QMutexLocker locker(&mutex);
     // copy outputs to where Command can see them:
     outputs = out;
 }
+
+//
+// connection pool, used by CommandExecutor
+//
+
+namespace
+{
+// Keeps connections to UI servers open between commands. Checking
+// out a connection is thread-safe; connections are RESET on check-in,
+// so no session state (options, files, recipients, ...) leaks from
+// one command into the next.
+class ConnectionPool
+{
+public:
+    static ConnectionPool &instance()
+    {
+        static ConnectionPool pool;
+        return pool;
+    }
+
+    QString checkout(const QString &socketName, AssuanClientContext &ctx, qint64 &serverPid)
+    {
+        {
+            const QMutexLocker locker(&mutex);
+            const std::vector<Connection>::iterator it
+                = std::find_if(idle.begin(), idle.end(), [&socketName](const Connection &c) {
+                    return c.socketName == socketName;
+                });
+            if (it != idle.end()) {
+                ctx = it->ctx;
+                serverPid = it->serverPid;
+                idle.erase(it);
+                return QString();
+            }
+        }
+        // connect outside the lock, this can take a while
+        return connect_to_uiserver(ctx, socketName, serverPid);
+    }
+
+    void checkin(const QString &socketName, const AssuanClientContext &ctx, qint64 serverPid)
+    {
+        if (const assuan_error_t err = my_assuan_transact(ctx, "RESET")) {
+            qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "RESET failed, dropping connection:" << to_error_string(err);
+            return;
+        }
+        const Connection c = { socketName, ctx, serverPid };
+        const QMutexLocker locker(&mutex);
+        if (idle.size() < maxIdle) {
+            idle.push_back(c);
+        }
+    }
+
+    void setMaximumIdleConnections(unsigned int max)
+    {
+        const QMutexLocker locker(&mutex);
+        maxIdle = max;
+        if (idle.size() > maxIdle) {
+            idle.resize(maxIdle);
+        }
+    }
+
+    void clear()
+    {
+        const QMutexLocker locker(&mutex);
+        idle.clear();
+    }
+
+private:
+    ConnectionPool() : maxIdle(4) {}
+
+private:
+    struct Connection {
+        QString socketName;
+        AssuanClientContext ctx;
+        qint64 serverPid;
+    };
+    QMutex mutex;
+    std::vector<Connection> idle;
+    unsigned int maxIdle;
+};
+}
+
+void Command::Private::runPooled()
+{
+
+    Q_EMIT q->started();
+
+    Inputs in;
+    Outputs out;
+    {
+        const QMutexLocker locker(&mutex);
+        in = inputs;
+        out.serverLocation = outputs.serverLocation;
+        outputs = Outputs();
+    }
+
+    if (out.serverLocation.isEmpty()) {
+        out.serverLocation = default_socket_name();
+    }
+
+    AssuanClientContext ctx;
+    out.errorString = ConnectionPool::instance().checkout(out.serverLocation, ctx, out.serverPid);
+    if (out.errorString.isEmpty()) {
+        allow_set_foreground_window(out.serverPid);
+        if (!in.command.isEmpty()) {
+            send_command(ctx, in, out);
+        }
+        // a failed command leaves the connection usable, unless the
+        // server went away; the RESET in checkin() tells us which
+        ConnectionPool::instance().checkin(out.serverLocation, ctx, out.serverPid);
+    }
+
+    {
+        const QMutexLocker locker(&mutex);
+        outputs = out;
+    }
+    {
+        const QMutexLocker locker(&pooledMutex);
+        pooledRunning = false;
+        pooledDone.wakeAll();
+    }
+
+    Q_EMIT q->finished();
+}
+
+bool Command::Private::waitForPooled(unsigned long ms)
+{
+    const QMutexLocker locker(&pooledMutex);
+    while (pooledRunning)
+        if (!pooledDone.wait(&pooledMutex, ms)) {
+            return false;
+        }
+    return true;
+}
+
+void CommandExecutor::setMaximumIdleConnections(unsigned int max)
+{
+    ConnectionPool::instance().setMaximumIdleConnections(max);
+}
+
+void CommandExecutor::closeIdleConnections()
+{
+    ConnectionPool::instance().clear();
+}
@@ -34,6 +34,8 @@ class QVariant;
 namespace KleopatraClientCopy
 {
 
+class CommandExecutor;
+
 class KLEOPATRACLIENTCORE_EXPORT Command : public QObject
 {
     Q_OBJECT
@@ -98,6 +100,9 @@ protected:
     class Private;
     Private *d;
     Command(Private *p, QObject *parent);
+
+private:
+    friend class ::KleopatraClientCopy::CommandExecutor;
 };
 
 }
@@ -25,6 +25,7 @@
 
 #include <QThread>
 #include <QMutex>
+#include <QWaitCondition>
 
 #include <QString>
 #include <QStringList>
@@ -39,6 +40,7 @@ class KleopatraClientCopy::Command::Private : public QThread
     Q_OBJECT
 private:
     friend class ::KleopatraClientCopy::Command;
+    friend class ::KleopatraClientCopy::CommandExecutor;
     Command *const q;
 public:
     explicit Private(Command *qq)
@@ -46,7 +48,8 @@ public:
           q(qq),
           mutex(QMutex::Recursive),
           inputs(),
-          outputs()
+          outputs(),
+          pooledRunning(false)
     {
 
     }
@@ -58,8 +61,11 @@ private:
 private:
     void run() override;
 
-private:
-    QMutex mutex;
+    // runs the command in the calling thread, over a pooled connection
+    void runPooled();
+    bool waitForPooled(unsigned long ms);
+
+public:
     struct Option {
         QVariant value;
         bool hasValue : 1;
@@ -75,7 +81,7 @@ private:
         QByteArray command;
         bool areRecipientsInformative : 1;
         bool areSendersInformative    : 1;
-    } inputs;
+    };
     struct Outputs {
         Outputs() : canceled(false), serverPid(0) {}
         QString errorString;
@@ -83,7 +89,18 @@ private:
         QByteArray data;
         qint64 serverPid;
         QString serverLocation;
-    } outputs;
+    };
+
+private:
+    QMutex mutex;
+    Inputs inputs;
+    Outputs outputs;
+
+    // state of a command run by a CommandExecutor (not covered by mutex,
+    // which is recursive, and so can't be used with a QWaitCondition):
+    QMutex pooledMutex;
+    QWaitCondition pooledDone;
+    bool pooledRunning;
 };
 
 #endif /* __LIBKLEOPATRACLIENT_CORE_COMMAND_P_H__ */
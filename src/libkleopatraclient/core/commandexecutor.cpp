@@ -0,0 +1,109 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    core/commandexecutor.cpp
+
+    This file is part of KleopatraClient, the Kleopatra interface library
+    Copyright (c) 2020 g10code GmbH
+
+    KleopatraClient is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    KleopatraClient is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <config-kleopatra.h>
+
+#include "commandexecutor.h"
+#include "command_p.h"
+
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutexLocker>
+
+using namespace KleopatraClientCopy;
+
+class CommandExecutor::Private
+{
+    friend class ::KleopatraClientCopy::CommandExecutor;
+public:
+    Private()
+    {
+        pool.setMaxThreadCount(4);
+    }
+
+private:
+    class Runnable : public QRunnable
+    {
+    public:
+        Runnable(Command *cmd, CommandExecutor *executor, const std::function<void()> &continuation)
+            : QRunnable(), command(cmd), executor(executor), continuation(continuation) {}
+
+        void run() override
+        {
+            command->d->runPooled();
+            if (continuation) {
+                QMetaObject::invokeMethod(executor, continuation, Qt::QueuedConnection);
+            }
+        }
+
+    private:
+        Command *const command;
+        CommandExecutor *const executor;
+        const std::function<void()> continuation;
+    };
+
+private:
+    QThreadPool pool;
+};
+
+CommandExecutor::CommandExecutor(QObject *p)
+    : QObject(p), d(new Private)
+{
+
+}
+
+CommandExecutor::~CommandExecutor()
+{
+    d->pool.waitForDone();
+    delete d; d = nullptr;
+}
+
+void CommandExecutor::setMaximumConnections(int max)
+{
+    d->pool.setMaxThreadCount(qMax(1, max));
+}
+
+int CommandExecutor::maximumConnections() const
+{
+    return d->pool.maxThreadCount();
+}
+
+bool CommandExecutor::waitForDone(int msecs)
+{
+    return d->pool.waitForDone(msecs);
+}
+
+void CommandExecutor::execute(Command *cmd)
+{
+    doExecute(cmd, std::function<void()>());
+}
+
+void CommandExecutor::doExecute(Command *cmd, const std::function<void()> &continuation)
+{
+    if (!cmd) {
+        return;
+    }
+    {
+        const QMutexLocker locker(&cmd->d->pooledMutex);
+        cmd->d->pooledRunning = true;
+    }
+    d->pool.start(new Private::Runnable(cmd, this, continuation));
+}
@@ -0,0 +1,103 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    core/commandexecutor.h
+
+    This file is part of KleopatraClient, the Kleopatra interface library
+    Copyright (c) 2020 g10code GmbH
+
+    KleopatraClient is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    KleopatraClient is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __LIBKLEOPATRACLIENT_CORE_COMMANDEXECUTOR_H__
+#define __LIBKLEOPATRACLIENT_CORE_COMMANDEXECUTOR_H__
+
+#include "kleopatraclientcore_export.h"
+
+#include <QObject>
+
+#include <functional>
+
+namespace KleopatraClientCopy
+{
+
+class Command;
+
+/*!
+  Runs Commands over a small set of pooled, persistent connections to
+  the UI server, on a fixed set of worker threads, instead of
+  starting a thread and opening a new connection for each
+  Command::start().
+
+  Connections are RESET between commands, so commands don't see each
+  other's options, files, senders or recipients. Commands emit
+  started() and finished() from the worker thread, as with start().
+
+  Commands can be given a continuation, which is called with the
+  finished command in the thread the executor lives in:
+
+  \code
+  executor->execute(cmd, [](SelectCertificateCommand *cmd) {
+      if (!cmd->error()) {
+          use(cmd->selectedCertificates());
+      }
+      delete cmd;
+  });
+  \endcode
+
+  Queued commands only cost their bookkeeping; at most
+  maximumConnections() of them run at the same time.
+*/
+class KLEOPATRACLIENTCORE_EXPORT CommandExecutor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CommandExecutor(QObject *parent = nullptr);
+    ~CommandExecutor();
+
+    // the number of commands run concurrently (default: 4)
+    void setMaximumConnections(int max);
+    int maximumConnections() const;
+
+    bool waitForDone(int msecs = -1);
+
+    // the number of connections kept open between commands, across
+    // all executors (default: 4)
+    static void setMaximumIdleConnections(unsigned int max);
+    static void closeIdleConnections();
+
+    // runs command, then calls continuation(command) in the thread the
+    // executor lives in (not at all, if the executor is gone by then)
+    template <typename T, typename Continuation>
+    void execute(T *command, Continuation continuation)
+    {
+        doExecute(command, [command, continuation]() {
+            continuation(command);
+        });
+    }
+
+public Q_SLOTS:
+    // the command must stay alive until it emitted finished()
+    void execute(KleopatraClientCopy::Command *command);
+
+private:
+    void doExecute(Command *command, const std::function<void()> &continuation);
+
+private:
+    class Private;
+    Private *d;
+};
+
+}
+
+#endif /* __LIBKLEOPATRACLIENT_CORE_COMMANDEXECUTOR_H__ */
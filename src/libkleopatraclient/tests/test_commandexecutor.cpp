@@ -0,0 +1,83 @@
+#include <libkleopatraclient/core/command.h>
+#include <libkleopatraclient/core/commandexecutor.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include <memory>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace KleopatraClientCopy;
+
+namespace
+{
+class GetInfoVersionCommand : public Command
+{
+public:
+    GetInfoVersionCommand() : Command()
+    {
+        setCommand("GETINFO version");
+    }
+};
+}
+
+// runs <count> (default: 100) small commands, first with a thread
+// and a connection each, then over a CommandExecutor
+int main(int argc, char *argv[])
+{
+
+    QCoreApplication app(argc, argv);
+
+    const int count = argc > 1 ? qMax(1, atoi(argv[1])) : 100;
+    int errors = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        GetInfoVersionCommand cmd;
+        cmd.start();
+        cmd.waitForFinished();
+        if (cmd.error()) {
+            fprintf(stderr, "Command::start: %s\n", qPrintable(cmd.errorString()));
+            ++errors;
+        }
+    }
+    const qint64 threaded = timer.elapsed();
+
+    std::vector< std::shared_ptr<GetInfoVersionCommand> > cmds;
+    for (int i = 0; i < count; ++i) {
+        cmds.push_back(std::make_shared<GetInfoVersionCommand>());
+    }
+
+    timer.restart();
+    {
+        CommandExecutor executor;
+        int done = 0;
+        for (const std::shared_ptr<GetInfoVersionCommand> &cmd : cmds) {
+            executor.execute(cmd.get(), [&done, &app, count](GetInfoVersionCommand *) {
+                if (++done == count) {
+                    app.quit();
+                }
+            });
+        }
+        app.exec();
+    }
+    const qint64 pooled = timer.elapsed();
+
+    for (const std::shared_ptr<GetInfoVersionCommand> &cmd : cmds)
+        if (cmd->error()) {
+            fprintf(stderr, "CommandExecutor: %s\n", qPrintable(cmd->errorString()));
+            ++errors;
+        } else if (cmd->receivedData().isEmpty()) {
+            fprintf(stderr, "CommandExecutor: no data received\n");
+            ++errors;
+        }
+
+    printf("%d commands: %lld ms with a thread each, %lld ms pooled\n",
+           count, static_cast<long long>(threaded), static_cast<long long>(pooled));
+
+    return errors ? 1 : 0;
+}
@@ -82,15 +82,18 @@
 #include <QEventLoop>
 #include <QThreadPool>
 #include <QElapsedTimer>
+#include <QPointer>
 
 #include <gpgme++/global.h>
 #include <gpgme++/error.h>
 
 #include <memory>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 #include <QCommandLineParser>
 
-static bool selfCheck()
+static bool selfCheck(bool *usedCachedResults)
 {
     Kleo::Commands::SelfTestCommand cmd(nullptr);
     cmd.setAutoDelete(false);
@@ -99,6 +102,7 @@ static bool selfCheck()
     QObject::connect(&cmd, &Kleo::Commands::SelfTestCommand::finished, &loop, &QEventLoop::quit);
     QTimer::singleShot(0, &cmd, &Kleo::Command::start);   // start() may Q_EMIT finished()...
     loop.exec();
+    *usedCachedResults = cmd.usedCachedResults();
     if (cmd.isCanceled()) {
         return false;
     } else {
@@ -106,11 +110,98 @@ static bool selfCheck()
     }
 }
 
-static void fillKeyCache(Kleo::UiServer *server)
+// the self-tests were skipped at startup because they passed before;
+// run them again, in case something changed that we can't detect
+static void revalidateSelfCheck()
+{
+    Kleo::Commands::SelfTestCommand *cmd = new Kleo::Commands::SelfTestCommand(nullptr);
+    cmd->setAutomaticMode(true);
+    cmd->setUseCachedResults(false);
+    cmd->start();
+}
+
+namespace
+{
+// Records when each startup phase began and ended. Phases may
+// overlap; once the last one has ended, they are logged as one report.
+class StartupReport
+{
+public:
+    StartupReport()
+        : m_complete(false), m_reported(false)
+    {
+        m_timer.start();
+    }
+
+    void begin(const char *phase)
+    {
+        const Phase p = { phase, m_timer.elapsed(), -1 };
+        m_phases.push_back(p);
+    }
+
+    void end(const char *phase)
+    {
+        const auto it = std::find_if(m_phases.begin(), m_phases.end(), [phase](const Phase &p) {
+            return p.end < 0 && qstrcmp(p.name, phase) == 0;
+        });
+        if (it == m_phases.end()) {
+            return;
+        }
+        it->end = m_timer.elapsed();
+        qCDebug(KLEOPATRA_LOG) << "Startup timing:" << it->end << "ms elapsed:" << phase << "done";
+        logIfDone();
+    }
+
+    // no more phases will begin
+    void setComplete()
+    {
+        m_complete = true;
+        logIfDone();
+    }
+
+private:
+    void logIfDone()
+    {
+        if (m_complete && !m_reported
+            && std::all_of(m_phases.cbegin(), m_phases.cend(), [](const Phase &p) { return p.end >= 0; })) {
+            m_reported = true;
+            log();
+        }
+    }
+
+    void log() const
+    {
+        qCDebug(KLEOPATRA_LOG) << "Startup report:" << m_timer.elapsed() << "ms total";
+        for (const Phase &p : m_phases) {
+            qCDebug(KLEOPATRA_LOG).noquote() << QStringLiteral("  %1 %2 .. %3 ms (%4 ms)")
+                                                .arg(QLatin1String(p.name), -12)
+                                                .arg(p.begin, 6).arg(p.end, 6).arg(p.end - p.begin, 6);
+        }
+    }
+
+private:
+    struct Phase {
+        const char *name;
+        qint64 begin;
+        qint64 end;
+    };
+    QElapsedTimer m_timer;
+    std::vector<Phase> m_phases;
+    bool m_complete;
+    bool m_reported;
+};
+}
+
+static QPointer<Kleo::ReloadKeysCommand> fillKeyCache(Kleo::UiServer *server, StartupReport *report)
 {
     Kleo::ReloadKeysCommand *cmd = new Kleo::ReloadKeysCommand(nullptr);
     QObject::connect(cmd, SIGNAL(finished()), server, SLOT(enableCryptoCommands()));
+    QObject::connect(cmd, &Kleo::Command::finished, [report]() {
+        report->end("keycache");
+    });
+    report->begin("keycache");
     cmd->start();
+    return cmd;
 }
 
 int main(int argc, char **argv)
@@ -120,9 +211,14 @@ int main(int argc, char **argv)
     KleopatraApplication app(argc, argv);
     KCrash::initialize();
 
-
-    QElapsedTimer timer;
-    timer.start();
+    // Startup phases, and what they wait for:
+    //   service, init, setup, gpgme:  run one after the other
+    //   keycache:                     gpgme; runs in the background from then on
+    //   uiserver, selfcheck:          gpgme; run while the keycache fills
+    //   smartcard, newinstance:       selfcheck
+    // A failed selfcheck cancels the keycache listing.
+    StartupReport report;
+    report.begin("service");
 
     KLocalizedString::setApplicationDomain("kleopatra");
 
@@ -136,9 +232,11 @@ int main(int argc, char **argv)
     // Delay init after KUniqueservice call as this might already
     // have terminated us and so we can avoid overhead (e.g. keycache
     // setup / systray icon).
-    qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: Service created";
+    report.end("service");
+    report.begin("init");
     app.init();
-    qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: Application initialized";
+    report.end("init");
+    report.begin("setup");
 
     AboutData aboutData;
 
@@ -157,7 +255,8 @@ int main(int argc, char **argv)
     migrate.setUiFiles(QStringList() << QStringLiteral("kleopatra.rc"));
     migrate.migrate();
 
-    qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: Application created";
+    report.end("setup");
+    report.begin("gpgme");
 
     // Initialize GpgME
     const GpgME::Error gpgmeInitError = GpgME::initializeLibrary(0);
@@ -176,15 +275,19 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: GPGME Initialized";
+    report.end("gpgme");
 
     Kleo::ChecksumDefinition::setInstallPath(Kleo::gpg4winInstallPath());
     Kleo::ArchiveDefinition::setInstallPath(Kleo::gnupgInstallPath());
 
     int rc;
     Kleo::UiServer server(parser.value(QStringLiteral("uiserver-socket")));
+
+    // start listing keys first, it takes longest:
+    const QPointer<Kleo::ReloadKeysCommand> reloadKeys = fillKeyCache(&server, &report);
+
+    report.begin("uiserver");
     try {
-        qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: UiServer created";
 
         QObject::connect(&server, &Kleo::UiServer::startKeyManagerRequested, &app, &KleopatraApplication::openOrRaiseMainWindow);
 
@@ -212,7 +315,6 @@ int main(int argc, char **argv)
 #undef REGISTER
 
         server.start();
-        qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: UiServer started";
     } catch (const std::exception &e) {
         qCDebug(KLEOPATRA_LOG) << "Failed to start UI Server: " << e.what();
 #ifdef Q_OS_WIN
@@ -227,29 +329,43 @@ int main(int argc, char **argv)
                                       QString::fromUtf8(e.what()).toHtmlEscaped()));
 #endif
     }
+    report.end("uiserver");
+
     const bool daemon = parser.isSet(QStringLiteral("daemon"));
     if (!daemon && app.isSessionRestored()) {
         app.restoreMainWindow();
     }
 
-    if (!selfCheck()) {
+    report.begin("selfcheck");
+    bool selfCheckCached = false;
+    if (!selfCheck(&selfCheckCached)) {
+        if (reloadKeys) {
+            reloadKeys->cancel();
+        }
         return EXIT_FAILURE;
     }
-    qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: SelfCheck completed";
+    report.end("selfcheck");
 
-    fillKeyCache(&server);
 #ifndef QT_NO_SYSTEMTRAYICON
+    report.begin("smartcard");
     app.startMonitoringSmartCard();
+    report.end("smartcard");
 #endif
     app.setIgnoreNewInstance(false);
 
     if (!daemon) {
+        report.begin("newinstance");
         const QString err = app.newInstance(parser);
         if (!err.isEmpty()) {
             std::cerr << i18n("Invalid arguments: %1", err).toLocal8Bit().constData() << "\n";
             return EXIT_FAILURE;
         }
-        qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: new instance created";
+        report.end("newinstance");
+    }
+    report.setComplete();
+
+    if (selfCheckCached) {
+        QTimer::singleShot(0, &revalidateSelfCheck);
     }
 
     rc = app.exec();
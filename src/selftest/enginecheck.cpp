@@ -46,9 +46,6 @@
 #include <KLocalizedString>
 #include "kleopatra_debug.h"
 
-#include <QGpgME/CryptoConfig>
-#include <QGpgME/Protocol>
-
 #include <QFile>
 
 #include <algorithm>
@@ -89,22 +86,8 @@ public:
 
     void runTest(GpgME::Engine eng)
     {
-        // First use the crypto config which is much faster because it is only
-        // created once and then kept in memory. Only if the crypoconfig is
-        // bad we check into the engine info.
-        const auto conf = QGpgME::cryptoConfig();
-        if (conf && eng == GpgME::GpgEngine) {
-            m_passed = true;
-            return;
-        } else if (conf) {
-            const auto comp = conf->component(engine_name(eng));
-            if (comp) {
-                m_passed = true;
-                return;
-            }
-        }
-
-        // Problem with the config. Try to get more details:
+        // This runs in a worker thread (see SelfTestCommand), so it must not
+        // use the CryptoConfig; GpgME's engine checks are thread-safe.
         const Error err = GpgME::checkEngine(eng);
         Q_ASSERT(!err.code() || err.code() == GPG_ERR_INV_ENGINE);
 
@@ -43,8 +43,7 @@
 #include <KLocalizedString>
 
 
-#include <QGpgME/CryptoConfig>
-#include <QGpgME/Protocol>
+#include <QProcess>
 
 
 using namespace Kleo;
@@ -53,6 +52,37 @@ using namespace Kleo::_detail;
 namespace
 {
 
+// Runs gpgconf with \a args and returns its output, or a null
+// QByteArray if it could not be run or failed.
+QByteArray run_gpgconf(const QString &gpgconf, const QStringList &args)
+{
+    QProcess process;
+    process.start(gpgconf, args);
+    if (!process.waitForFinished()) {
+        qCDebug(KLEOPATRA_LOG) << "gpgconf" << args << "did not finish:" << process.errorString();
+        return QByteArray();
+    }
+    if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        qCDebug(KLEOPATRA_LOG) << "gpgconf" << args << "failed:" << process.readAllStandardError().constData();
+        return QByteArray();
+    }
+    const QByteArray output = process.readAllStandardOutput();
+    return output.isNull() ? QByteArray("") : output;
+}
+
+// Returns the fields of the line of \a output that is about \a component.
+QList<QByteArray> component_fields(const QByteArray &output, const QString &component)
+{
+    const QByteArray prefix = component.toLatin1() + ':';
+    const QList<QByteArray> lines = output.split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith(prefix)) {
+            return line.trimmed().split(':');
+        }
+    }
+    return QList<QByteArray>();
+}
+
 class GpgConfCheck : public SelfTestImplementation
 {
     QString m_component;
@@ -64,28 +94,33 @@ public:
         runTest();
     }
 
+    // This runs in a worker thread (see SelfTestCommand), so it asks
+    // gpgconf directly instead of going through the CryptoConfig.
     void runTest()
     {
-        const auto conf = QGpgME::cryptoConfig();
+        const QString gpgconf = gpgConfPath();
         QString message;
         m_passed = true;
 
-        if (!conf) {
+        const QByteArray components = gpgconf.isEmpty() ? QByteArray() : run_gpgconf(gpgconf, QStringList() << QStringLiteral("--list-components"));
+        if (components.isNull()) {
             message = QStringLiteral ("Could not be started.");
             m_passed = false;
-        } else if (m_component.isEmpty() && conf->componentList().empty()) {
+        } else if (m_component.isEmpty() && components.trimmed().isEmpty()) {
             message = QStringLiteral ("Could not list components.");
             m_passed = false;
         } else if (!m_component.isEmpty()) {
-            const auto comp = conf->component (m_component);
-            if (!comp) {
+            // gpgconf only lists components whose binary it finds
+            if (component_fields(components, m_component).isEmpty()) {
                 message = QStringLiteral ("Binary could not be found.");
                 m_passed = false;
-            } else if (comp->groupList().empty()) {
-                // If we don't have any group it means that list-options
-                // for this component failed.
-                message = QStringLiteral ("The configuration file is invalid.");
-                m_passed = false;
+            } else {
+                // name:description:pgmname:avail:okay[:cfgfile:line:error]
+                const QList<QByteArray> fields = component_fields(run_gpgconf(gpgconf, QStringList() << QStringLiteral("--check-options") << m_component), m_component);
+                if (fields.size() < 5 || fields[4] != "1") {
+                    message = QStringLiteral ("The configuration file is invalid.");
+                    m_passed = false;
+                }
             }
         }
 
@@ -218,6 +218,17 @@ public:
 
     virtual const char *name() const = 0;
 
+    // what a command needs from the KeyCache before it can start:
+    enum KeyCacheRequirement {
+        NoKeyCacheRequired,   // the backend looks up keys itself (DECRYPT, VERIFY, ...)
+        TargetedKeyListing,   // keys for the command's recipients and senders suffice
+        FullKeyCacheRequired  // needs the complete listing (e.g. certificate selection)
+    };
+    virtual KeyCacheRequirement keyCacheRequirement() const
+    {
+        return FullKeyCacheRequired;
+    }
+
     class Memento
     {
     public:
@@ -309,6 +320,10 @@ public:
     QStringList fileNames() const;
     unsigned int numFiles() const;
 
+    // parses a newline-separated list of percent-encoded, absolute file
+    // names (as sent in reply to an INQUIRE FILES), checking each like FILE
+    static QStringList parseFileList(const QByteArray &data);
+
     void sendStatus(const char *keyword, const QString &text);
     void sendStatusEncoded(const char *keyword, const std::string &text);
     void sendData(const QByteArray &data, bool moreToCome = false);
@@ -332,6 +347,7 @@ private:
 
 private:
     void doApplyWindowID(QWidget *w) const;
+    void recordStatistics(bool error);
 
 private:
     const std::map< QByteArray, std::shared_ptr<Memento> > &mementos() const;
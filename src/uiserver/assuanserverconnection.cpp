@@ -48,8 +48,10 @@
 #include <utils/gnupg-helper.h>
 #include <utils/detail_p.h>
 #include <utils/hex.h>
+#include <utils/assuanoptions.h>
 #include <utils/log.h>
 #include <utils/kleo_assert.h>
+#include <utils/keylisting.h>
 
 #include <Libkleo/Stl_Util>
 #include <Libkleo/Exception>
@@ -73,6 +75,7 @@
 #include <QRegExp>
 #include <QWidget>
 #include <QCoreApplication>
+#include <QElapsedTimer>
 
 #include <kleo-assuan.h>
 
@@ -151,67 +154,117 @@ static inline gpg_error_t assuan_process_done_msg(assuan_context_t ctx, gpg_erro
     return assuan_process_done_msg(ctx, err, err_msg.toUtf8().constData());
 }
 
-static std::map<std::string, std::string> upcase_option(const char *option, std::map<std::string, std::string> options)
+namespace
 {
-    std::string value;
-    bool value_found = false;
-    std::map<std::string, std::string>::iterator it = options.begin();
-    while (it != options.end())
-        if (qstricmp(it->first.c_str(), option) == 0) {
-            value = it->second;
-            options.erase(it++);
-            value_found = true;
-        } else {
-            ++it;
+
+// Process-wide per-command statistics, shared by all connections and
+// reported by GETINFO x-stats. Latencies are recorded in microseconds
+// into power-of-two buckets, so percentiles are upper bounds of the
+// bucket they fall into (clamped to the observed maximum).
+class CommandStatistics
+{
+public:
+    static CommandStatistics &instance()
+    {
+        static CommandStatistics stats;
+        return stats;
+    }
+
+    void record(const char *command, qint64 usecs, unsigned long long bytes, bool error)
+    {
+        Entry &e = entries[command];
+        ++e.count;
+        if (error) {
+            ++e.errors;
+        }
+        e.bytes += bytes;
+        if (usecs < 0) {
+            usecs = 0;
         }
-    if (value_found) {
-        options[option] = value;
+        e.maxUsecs = std::max(e.maxUsecs, static_cast<quint64>(usecs));
+        ++e.histogram[bucket(usecs)];
     }
-    return options;
-}
 
-static std::map<std::string, std::string> parse_commandline(const char *line)
-{
-    std::map<std::string, std::string> result;
-    if (line) {
-        const char *begin = line;
-        const char *lastEQ = nullptr;
-        while (*line) {
-            if (*line == ' ' || *line == '\t') {
-                if (begin != line) {
-                    if (begin[0] == '-' && begin[1] == '-') {
-                        begin += 2;    // skip initial "--"
-                    }
-                    if (lastEQ && lastEQ > begin) {
-                        result[ std::string(begin, lastEQ - begin) ] = hexdecode(std::string(lastEQ + 1, line - (lastEQ + 1)));
-                    } else {
-                        result[ std::string(begin,  line  - begin) ] = std::string();
-                    }
-                }
-                begin = line + 1;
-            } else if (*line == '=') {
-                if (line == begin)
-                    throw Exception(gpg_error(GPG_ERR_ASS_SYNTAX),
-                                    i18n("No option name given"));
-                else {
-                    lastEQ = line;
-                }
-            }
-            ++line;
+    void reset()
+    {
+        entries.clear();
+    }
+
+    QByteArray dump() const
+    {
+        QByteArray result;
+        for (std::map<std::string, Entry>::const_iterator it = entries.begin(), end = entries.end(); it != end; ++it) {
+            const Entry &e = it->second;
+            result += QByteArray(it->first.c_str())
+                      + " count=" + QByteArray::number(e.count)
+                      + " errors=" + QByteArray::number(e.errors)
+                      + " bytes=" + QByteArray::number(e.bytes)
+                      + " p50=" + QByteArray::number(percentile(e, 50))
+                      + " p95=" + QByteArray::number(percentile(e, 95))
+                      + " p99=" + QByteArray::number(percentile(e, 99))
+                      + " max=" + QByteArray::number(e.maxUsecs)
+                      + '\n';
         }
-        if (begin != line) {
-            if (begin[0] == '-' && begin[1] == '-') {
-                begin += 2;    // skip initial "--"
-            }
-            if (lastEQ && lastEQ > begin) {
-                result[ std::string(begin, lastEQ - begin) ] = hexdecode(std::string(lastEQ + 1, line - (lastEQ + 1)));
-            } else {
-                result[ begin ] = std::string();
+        return result;
+    }
+
+private:
+    enum { NumBuckets = 40 }; // 2^40us is about 12 days
+
+    struct Entry {
+        Entry() : count(0), errors(0), bytes(0), maxUsecs(0)
+        {
+            std::fill(histogram, histogram + NumBuckets, 0);
+        }
+        quint64 count, errors, bytes, maxUsecs;
+        quint64 histogram[NumBuckets]; // bucket i holds [2^i, 2^(i+1)) us
+    };
+
+    static unsigned int bucket(qint64 usecs)
+    {
+        unsigned int i = 0;
+        while (usecs > 1 && i < NumBuckets - 1) {
+            usecs >>= 1;
+            ++i;
+        }
+        return i;
+    }
+
+    static quint64 percentile(const Entry &e, unsigned int p)
+    {
+        if (!e.count) {
+            return 0;
+        }
+        const quint64 rank = (e.count * p + 99) / 100;
+        quint64 seen = 0;
+        for (unsigned int i = 0; i < NumBuckets; ++i) {
+            seen += e.histogram[i];
+            if (seen >= rank) {
+                return std::min(quint64(2) << i, e.maxUsecs);
             }
         }
+        return e.maxUsecs;
     }
 
-    return result;
+    std::map<std::string, Entry> entries;
+};
+
+}
+
+// throws gpg_error_t, like the FILE handler always did
+static QString check_file_name(const QString &fileName)
+{
+    const QFileInfo fi(fileName);
+    if (!fi.isAbsolute()) {
+        throw Exception(gpg_error(GPG_ERR_INV_ARG), i18n("Only absolute file paths are allowed"));
+    }
+    if (!fi.exists()) {
+        throw gpg_error(GPG_ERR_ENOENT);
+    }
+    if (!fi.isReadable() || (fi.isDir() && !fi.isExecutable())) {
+        throw gpg_error(GPG_ERR_EPERM);
+    }
+    return fi.absoluteFilePath();
 }
 
 static WId wid_from_string(const QString &winIdStr, bool *ok = nullptr)
@@ -283,6 +336,8 @@ public Q_SLOTS:
     int startCommandBottomHalf();
 
 private:
+    bool startTargetedKeyListing();
+
     void nohupDone(AssuanCommand *cmd)
     {
         const auto it = std::find_if(nohupedCommands.begin(), nohupedCommands.end(),
@@ -454,6 +509,8 @@ private:
             ba = conn.dumpRecipients();
         } else if (qstrcmp(line, "x-files") == 0) {
             ba = conn.dumpFiles();
+        } else if (qstrcmp(line, "x-stats") == 0) {
+            ba = CommandStatistics::instance().dump();
         } else {
             static const QString errorString = i18n("Unknown value for WHAT");
             return assuan_process_done_msg(ctx_, gpg_error(GPG_ERR_ASS_PARAMETER), errorString);
@@ -501,6 +558,23 @@ private:
         return assuan_process_done(ctx_, 0);
     }
 
+#ifndef HAVE_ASSUAN2
+    static int reset_stats_handler(assuan_context_t ctx_, char *line)
+    {
+#else
+    static gpg_error_t reset_stats_handler(assuan_context_t ctx_, char *line)
+    {
+#endif
+        if (line && *line) {
+            static const QString errorString = i18n("X_RESET_STATS does not take arguments");
+            return assuan_process_done_msg(ctx_, gpg_error(GPG_ERR_ASS_PARAMETER), errorString);
+        }
+
+        CommandStatistics::instance().reset();
+
+        return assuan_process_done(ctx_, 0);
+    }
+
     template <bool in>
     struct Input_or_Output : std::conditional<in, Input, Output> {};
 
@@ -527,24 +601,32 @@ private:
 
         try {
 
-            /*const*/ std::map<std::string, std::string> options = upcase_option("FD", upcase_option("FILE", parse_commandline(line_)));
+            AssuanOptions options;
+            parseAssuanOptions(line_, options);
             if (options.size() < 1 || options.size() > 2) {
                 throw gpg_error(GPG_ERR_ASS_SYNTAX);
             }
 
+            const AssuanOption *const fdOption = findAssuanOption(options, "FD", false);
+            const AssuanOption *const fileOption = findAssuanOption(options, "FILE", false);
+            const int unknownOptions = std::count_if(options.cbegin(), options.cend(),
+                                                     [](const AssuanOption &o) {
+                                                         return qstricmp(o.name, "FD") != 0 && qstricmp(o.name, "FILE") != 0;
+                                                     });
+
             std::shared_ptr< typename Input_or_Output<in>::type > io;
 
-            if (options.count("FD")) {
+            if (fdOption) {
 
-                if (options.count("FILE")) {
+                if (fileOption) {
                     throw gpg_error(GPG_ERR_CONFLICT);
                 }
 
                 assuan_fd_t fd = ASSUAN_INVALID_FD;
 
-                const std::string fdstr = options["FD"];
+                const char *const fdstr = fdOption->value;
 
-                if (fdstr.empty()) {
+                if (!*fdstr) {
                     if (const gpg_error_t err = assuan_receivefd(conn.ctx.get(), &fd)) {
                         throw err;
                     }
@@ -558,15 +640,9 @@ private:
 
                 io = Input_or_Output<in>::type::createFromPipeDevice(fd, in ? i18n("Message #%1", (conn.*which).size() + 1) : QString());
 
-                options.erase("FD");
-
-            } else if (options.count("FILE")) {
-
-                if (options.count("FD")) {
-                    throw gpg_error(GPG_ERR_CONFLICT);
-                }
+            } else if (fileOption) {
 
-                const QString filePath = QFile::decodeName(options["FILE"].c_str());
+                const QString filePath = QFile::decodeName(fileOption->value);
                 if (filePath.isEmpty()) {
                     throw Exception(gpg_error(GPG_ERR_ASS_SYNTAX), i18n("Empty file path"));
                 }
@@ -580,15 +656,13 @@ private:
                     io = Input_or_Output<in>::type::createFromFile(fi.absoluteFilePath(), true);
                 }
 
-                options.erase("FILE");
-
             } else {
 
                 throw gpg_error(GPG_ERR_ASS_PARAMETER);
 
             }
 
-            if (options.size()) {
+            if (unknownOptions) {
                 throw gpg_error(GPG_ERR_UNKNOWN_OPTION);
             }
 
@@ -656,18 +730,8 @@ private:
         AssuanServerConnection::Private &conn = *static_cast<AssuanServerConnection::Private *>(assuan_get_pointer(ctx_));
 
         try {
-            const QFileInfo fi(QFile::decodeName(hexdecode(line).c_str()));
-            if (!fi.isAbsolute()) {
-                throw Exception(gpg_error(GPG_ERR_INV_ARG), i18n("Only absolute file paths are allowed"));
-            }
-            if (!fi.exists()) {
-                throw gpg_error(GPG_ERR_ENOENT);
-            }
-            if (!fi.isReadable() || (fi.isDir() && !fi.isExecutable())) {
-                throw gpg_error(GPG_ERR_EPERM);
-            }
-
-            conn.files.push_back(fi.absoluteFilePath());
+            *hexdecodeInPlace(line, line + qstrlen(line)) = '\0';
+            conn.files.push_back(check_file_name(QFile::decodeName(line)));
 
             return assuan_process_done(conn.ctx.get(), 0);
         } catch (const Exception &e) {
@@ -870,6 +934,8 @@ private:
     bool closed                : 1;
     bool cryptoCommandsEnabled : 1;
     bool commandWaitingForCryptoCommandsEnabled : 1;
+    bool targetedKeyListingRunning : 1;
+    bool targetedKeyListingDone : 1;
     bool currentCommandIsNohup : 1;
     bool informativeSenders;    // address taken, so no : 1
     bool informativeRecipients; // address taken, so no : 1
@@ -895,6 +961,8 @@ void AssuanServerConnection::Private::cleanup()
     currentCommand.reset();
     currentCommandIsNohup = false;
     commandWaitingForCryptoCommandsEnabled = false;
+    targetedKeyListingRunning = false;
+    targetedKeyListingDone = false;
     notifiers.clear();
     ctx.reset();
     fd = ASSUAN_INVALID_FD;
@@ -907,6 +975,8 @@ AssuanServerConnection::Private::Private(assuan_fd_t fd_, const std::vector< std
       closed(false),
       cryptoCommandsEnabled(false),
       commandWaitingForCryptoCommandsEnabled(false),
+      targetedKeyListingRunning(false),
+      targetedKeyListingDone(false),
       currentCommandIsNohup(false),
       informativeSenders(false),
       informativeRecipients(false),
@@ -1018,6 +1088,12 @@ AssuanServerConnection::Private::Private(assuan_fd_t fd_, const std::vector< std
     if (const gpg_error_t err = assuan_register_command(ctx.get(), "START_CONFDIALOG", start_confdialog_handler, ""))
 #endif
         throw Exception(err, "register \"START_CONFDIALOG\" handler");
+#ifndef HAVE_ASSUAN2
+    if (const gpg_error_t err = assuan_register_command(ctx.get(), "X_RESET_STATS", reset_stats_handler))
+#else
+    if (const gpg_error_t err = assuan_register_command(ctx.get(), "X_RESET_STATS", reset_stats_handler, ""))
+#endif
+        throw Exception(err, "register \"X_RESET_STATS\" handler");
 #ifndef HAVE_ASSUAN2
     if (const gpg_error_t err = assuan_register_command(ctx.get(), "RECIPIENT", recipient_handler))
 #else
@@ -1082,6 +1158,7 @@ void AssuanServerConnection::enableCryptoCommands(bool on)
     }
     d->cryptoCommandsEnabled = on;
     if (d->commandWaitingForCryptoCommandsEnabled) {
+        d->commandWaitingForCryptoCommandsEnabled = false;
         QTimer::singleShot(0, d.get(), &Private::startCommandBottomHalf);
     }
 }
@@ -1161,7 +1238,8 @@ public:
           informativeSenders(false),
           bias(GpgME::UnknownProtocol),
           done(false),
-          nohup(false)
+          nohup(false),
+          bytesTransferred(0)
     {
 
     }
@@ -1179,6 +1257,8 @@ public:
     AssuanContext ctx;
     bool done;
     bool nohup;
+    QElapsedTimer timer;
+    unsigned long long bytesTransferred;
 };
 
 AssuanCommand::AssuanCommand()
@@ -1225,10 +1305,28 @@ int AssuanCommand::start()
 
 void AssuanCommand::canceled()
 {
+    if (!d->done) {
+        recordStatistics(true);
+    }
     d->done = true;
     doCanceled();
 }
 
+void AssuanCommand::recordStatistics(bool error)
+{
+    unsigned long long bytes = d->bytesTransferred;
+    for (const std::shared_ptr<Input> &i : d->inputs) {
+        bytes += i->size();
+    }
+    for (const std::shared_ptr<Input> &i : d->messages) {
+        bytes += i->size();
+    }
+    for (const std::shared_ptr<Output> &o : d->outputs) {
+        bytes += o->bytesWritten();
+    }
+    CommandStatistics::instance().record(name(), d->timer.isValid() ? d->timer.nsecsElapsed() / 1000 : 0, bytes, error);
+}
+
 // static
 int AssuanCommand::makeError(int code)
 {
@@ -1364,6 +1462,27 @@ unsigned int AssuanCommand::numFiles() const
     return d->files.size();
 }
 
+// static
+QStringList AssuanCommand::parseFileList(const QByteArray &data)
+{
+    QStringList result;
+    for (QByteArray line : data.split('\n')) {
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        if (line.isEmpty()) {
+            continue;
+        }
+        const QString fileName = QFile::decodeName(hexdecode(line));
+        try {
+            result.push_back(check_file_name(fileName));
+        } catch (const gpg_error_t &err) {
+            throw Exception(err, i18n("Cannot use \"%1\"", fileName));
+        }
+    }
+    return result;
+}
+
 void AssuanCommand::sendStatus(const char *keyword, const QString &text)
 {
     sendStatusEncoded(keyword, text.toUtf8().constData());
@@ -1387,6 +1506,7 @@ void  AssuanCommand::sendData(const QByteArray &data, bool moreToCome)
     if (const gpg_error_t err = assuan_send_data(d->ctx.get(), data.constData(), data.size())) {
         throw Exception(err, i18n("Cannot send data"));
     }
+    d->bytesTransferred += data.size();
     if (!moreToCome)
         if (const gpg_error_t err = assuan_send_data(d->ctx.get(), nullptr, 0)) {   // flush
             throw Exception(err, i18n("Cannot flush data"));
@@ -1445,6 +1565,8 @@ void AssuanCommand::done(const GpgME::Error &err)
 
     d->done = true;
 
+    recordStatistics(err.code() != GPG_ERR_NO_ERROR);
+
     std::for_each(d->messages.begin(), d->messages.end(), std::mem_fn(&Input::finalize));
     std::for_each(d->inputs.begin(), d->inputs.end(), std::mem_fn(&Input::finalize));
     std::for_each(d->outputs.begin(), d->outputs.end(), std::mem_fn(&Output::finalize));
@@ -1538,6 +1660,7 @@ gpg_error_t AssuanCommandFactory::_handle(assuan_context_t ctx, char *line, cons
         const std::shared_ptr<AssuanCommand> cmd = (*it)->create();
         kleo_assert(cmd);
 
+        cmd->d->timer.start();
         cmd->d->ctx     = conn.ctx;
         cmd->d->options = conn.options;
         cmd->d->inputs.swap(conn.inputs);     kleo_assert(conn.inputs.empty());
@@ -1552,9 +1675,10 @@ gpg_error_t AssuanCommandFactory::_handle(assuan_context_t ctx, char *line, cons
         cmd->d->sessionTitle          = conn.sessionTitle;
         cmd->d->sessionId             = conn.sessionId;
 
-        const std::map<std::string, std::string> cmdline_options = parse_commandline(line);
-        for (std::map<std::string, std::string>::const_iterator it = cmdline_options.begin(), end = cmdline_options.end(); it != end; ++it) {
-            cmd->d->options[it->first] = QString::fromUtf8(it->second.c_str());
+        AssuanOptions cmdline_options;
+        parseAssuanOptions(line, cmdline_options);
+        for (const AssuanOption &option : cmdline_options) {
+            cmd->d->options[option.name] = QString::fromUtf8(option.value);
         }
 
         bool nohup = false;
@@ -1568,6 +1692,8 @@ gpg_error_t AssuanCommandFactory::_handle(assuan_context_t ctx, char *line, cons
 
         conn.currentCommand = cmd;
         conn.currentCommandIsNohup = nohup;
+        conn.targetedKeyListingRunning = false;
+        conn.targetedKeyListingDone = false;
 
         QTimer::singleShot(0, &conn, &AssuanServerConnection::Private::startCommandBottomHalf);
 
@@ -1582,21 +1708,77 @@ gpg_error_t AssuanCommandFactory::_handle(assuan_context_t ctx, char *line, cons
     }
 }
 
-int AssuanServerConnection::Private::startCommandBottomHalf()
+// Lists only the keys for the current command's recipients and
+// senders, and feeds them into the KeyCache, so the command need not
+// wait for the full listing. Returns false if no listing was started.
+bool AssuanServerConnection::Private::startTargetedKeyListing()
 {
+    QStringList patterns;
+    for (const std::vector<KMime::Types::Mailbox> *mbs : { &currentCommand->recipients(), &currentCommand->senders() }) {
+        for (const KMime::Types::Mailbox &mb : *mbs) {
+            if (mb.hasAddress()) {
+                patterns.push_back(QLatin1Char('<') + QString::fromUtf8(mb.address()) + QLatin1Char('>'));
+            }
+        }
+    }
+    patterns.removeDuplicates();
+    if (patterns.empty()) {
+        return false;
+    }
 
-    commandWaitingForCryptoCommandsEnabled = currentCommand && !cryptoCommandsEnabled;
+    const std::weak_ptr<AssuanCommand> cmd = currentCommand;
+    // with the secret keys merged in, like the KeyCache lists them, so
+    // that signing keys are found:
+    return listKeysWithSecrets(this, patterns, patterns, [this, cmd](const std::vector<GpgME::Key> &keys, bool) {
+        // Once the full listing is done, the KeyCache has these keys
+        // already; don't replace them:
+        if (!cryptoCommandsEnabled && !keys.empty()) {
+            KeyCache::mutableInstance()->insert(keys);
+        }
+        // the command may have been started (full listing done) or canceled meanwhile:
+        const std::shared_ptr<AssuanCommand> c = cmd.lock();
+        if (c && c == currentCommand && commandWaitingForCryptoCommandsEnabled) {
+            commandWaitingForCryptoCommandsEnabled = false;
+            targetedKeyListingRunning = false;
+            targetedKeyListingDone = true;
+            QTimer::singleShot(0, this, &Private::startCommandBottomHalf);
+        }
+    });
+}
 
-    if (!cryptoCommandsEnabled) {
+int AssuanServerConnection::Private::startCommandBottomHalf()
+{
+
+    if (!currentCommand) {
+        commandWaitingForCryptoCommandsEnabled = false;
         return 0;
     }
 
-    const std::shared_ptr<AssuanCommand> cmd = currentCommand;
-    if (!cmd) {
-        return 0;
+    if (!cryptoCommandsEnabled) {
+        switch (currentCommand->keyCacheRequirement()) {
+        case AssuanCommand::NoKeyCacheRequired:
+            break;
+        case AssuanCommand::TargetedKeyListing:
+            if (targetedKeyListingDone) {
+                break;
+            }
+            if (!targetedKeyListingRunning) {
+                // if it can't be started, wait for the full listing instead:
+                targetedKeyListingRunning = startTargetedKeyListing();
+            }
+            commandWaitingForCryptoCommandsEnabled = true;
+            return 0;
+        case AssuanCommand::FullKeyCacheRequired:
+            commandWaitingForCryptoCommandsEnabled = true;
+            return 0;
+        }
     }
 
+    const std::shared_ptr<AssuanCommand> cmd = currentCommand;
     currentCommand.reset();
+    commandWaitingForCryptoCommandsEnabled = false;
+    targetedKeyListingRunning = false;
+    targetedKeyListingDone = false;
 
     const bool nohup = currentCommandIsNohup;
     currentCommandIsNohup = false;
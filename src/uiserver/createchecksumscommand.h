@@ -48,6 +48,11 @@ public:
     CreateChecksumsCommand();
     ~CreateChecksumsCommand() override;
 
+    KeyCacheRequirement keyCacheRequirement() const override
+    {
+        return NoKeyCacheRequired;
+    }
+
     static const char *staticName()
     {
         return "CHECKSUM_CREATE_FILES";
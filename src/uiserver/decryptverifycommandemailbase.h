@@ -47,6 +47,11 @@ public:
     explicit DecryptVerifyCommandEMailBase();
     ~DecryptVerifyCommandEMailBase() override;
 
+    KeyCacheRequirement keyCacheRequirement() const override
+    {
+        return NoKeyCacheRequired;
+    }
+
 private:
     virtual DecryptVerifyOperation operation() const = 0;
     virtual Mode mode() const
@@ -58,6 +58,7 @@
 #include <KLocalizedString>
 
 #include <QFileInfo>
+#include <QThread>
 
 #include <gpg-error.h>
 
@@ -86,10 +87,14 @@ public:
     }
 
     void checkForErrors() const;
+    void checkFiles(const QStringList &fileNames) const;
+    void startController(const QStringList &fileNames);
 
 public Q_SLOTS:
     void slotProgress(const QString &what, int current, int total);
     void verificationResult(const GpgME::VerificationResult &);
+    void slotFileListInquired(int, const QByteArray &);
+    void slotTaskCompleted(const QString &, const std::shared_ptr<const Kleo::Crypto::Task::Result> &);
     void slotDone()
     {
         q->done();
@@ -118,26 +123,76 @@ int DecryptVerifyCommandFilesBase::doStart()
 
     d->checkForErrors();
 
+    // in batch mode, the files are additionally inquired, and results
+    // are reported per file as they come in
+    if (hasOption("batch")) {
+        return inquire("FILES", d.get(), SLOT(slotFileListInquired(int,QByteArray)));
+    }
+
+    d->startController(fileNames());
+
+    return 0;
+}
+
+void DecryptVerifyCommandFilesBase::Private::startController(const QStringList &fileNames)
+{
     FileOperationsPreferences prefs;
     if (prefs.autoDecryptVerify()) {
-        d->controller.reset(new AutoDecryptVerifyFilesController());
+        controller.reset(new AutoDecryptVerifyFilesController());
     } else {
-        d->controller.reset(new DecryptVerifyFilesController(shared_from_this()));
+        controller.reset(new DecryptVerifyFilesController(q->shared_from_this()));
     }
 
-    d->controller->setOperation(operation());
-    d->controller->setFiles(fileNames());
+    controller->setOperation(q->operation());
+    controller->setFiles(fileNames);
 
-    QObject::connect(d->controller.get(), SIGNAL(done()),
-                     d.get(), SLOT(slotDone()), Qt::QueuedConnection);
-    QObject::connect(d->controller.get(), SIGNAL(error(int,QString)),
-                     d.get(), SLOT(slotError(int,QString)), Qt::QueuedConnection);
-    QObject::connect(d->controller.get(), &DecryptVerifyFilesController::verificationResult,
-                     d.get(), &Private::verificationResult, Qt::QueuedConnection);
+    if (q->hasOption("batch")) {
+        controller->setMaximumConcurrentTasks(QThread::idealThreadCount());
+        connect(controller.get(), &Controller::taskCompleted, this, &Private::slotTaskCompleted);
+    }
 
-    d->controller->start();
+    QObject::connect(controller.get(), SIGNAL(done()),
+                     this, SLOT(slotDone()), Qt::QueuedConnection);
+    QObject::connect(controller.get(), SIGNAL(error(int,QString)),
+                     this, SLOT(slotError(int,QString)), Qt::QueuedConnection);
+    QObject::connect(controller.get(), &DecryptVerifyFilesController::verificationResult,
+                     this, &Private::verificationResult, Qt::QueuedConnection);
 
-    return 0;
+    controller->start();
+}
+
+void DecryptVerifyCommandFilesBase::Private::slotFileListInquired(int rc, const QByteArray &data)
+{
+    if (rc) {
+        q->done(rc);
+        return;
+    }
+
+    try {
+        const QStringList fileNames = q->fileNames() + parseFileList(data);
+        if (fileNames.empty())
+            throw Exception(makeError(GPG_ERR_ASS_NO_INPUT),
+                            i18n("At least one file must be given"));
+        checkFiles(fileNames);
+        startController(fileNames);
+    } catch (const Exception &e) {
+        q->done(e.error(), e.message());
+    } catch (const std::exception &e) {
+        q->done(makeError(GPG_ERR_UNEXPECTED),
+                i18n("Caught unexpected exception in DecryptVerifyCommandFilesBase::Private::slotFileListInquired: %1",
+                     QString::fromLocal8Bit(e.what())));
+    } catch (...) {
+        q->done(makeError(GPG_ERR_UNEXPECTED),
+                i18n("Caught unknown exception in DecryptVerifyCommandFilesBase::Private::slotFileListInquired"));
+    }
+}
+
+void DecryptVerifyCommandFilesBase::Private::slotTaskCompleted(const QString &label, const std::shared_ptr<const Task::Result> &result)
+{
+    try {
+        q->sendStatusEncoded("FILE_DONE",
+                             std::to_string(result ? result->errorCode() : 0) + ' ' + hexencode(label.toUtf8().constData()));
+    } catch (...) {}
 }
 
 namespace
@@ -176,13 +231,17 @@ void DecryptVerifyCommandFilesBase::Private::checkForErrors() const
         throw Kleo::Exception(q->makeError(GPG_ERR_CONFLICT), i18n("OUTPUT present"));
     }
     const QStringList fileNames = q->fileNames();
-    if (fileNames.empty())
+    if (fileNames.empty() && !q->hasOption("batch"))
         throw Exception(makeError(GPG_ERR_ASS_NO_INPUT),
                         i18n("At least one FILE must be present"));
+    checkFiles(fileNames);
+}
+
+void DecryptVerifyCommandFilesBase::Private::checkFiles(const QStringList &fileNames) const
+{
     if (!std::all_of(fileNames.cbegin(), fileNames.cend(), is_file()))
         throw Exception(makeError(GPG_ERR_INV_ARG),
                         i18n("DECRYPT/VERIFY_FILES cannot use directories as input"));
-
 }
 
 void DecryptVerifyCommandFilesBase::doCanceled()
@@ -61,6 +61,11 @@ public:
     explicit DecryptVerifyCommandFilesBase();
     ~DecryptVerifyCommandFilesBase() override;
 
+    KeyCacheRequirement keyCacheRequirement() const override
+    {
+        return NoKeyCacheRequired;
+    }
+
 private:
     virtual DecryptVerifyOperation operation() const = 0;
 
@@ -68,6 +68,11 @@ public:
     EchoCommand();
     ~EchoCommand() override;
 
+    KeyCacheRequirement keyCacheRequirement() const override
+    {
+        return NoKeyCacheRequired;
+    }
+
     static const char *staticName()
     {
         return "ECHO";
@@ -45,6 +45,11 @@ class EncryptCommand : public Kleo::AssuanCommandMixin<EncryptCommand>
 public:
     EncryptCommand();
     ~EncryptCommand() override;
+
+    KeyCacheRequirement keyCacheRequirement() const override
+    {
+        return TargetedKeyListing;
+    }
 private:
     int doStart() override;
     void doCanceled() override;
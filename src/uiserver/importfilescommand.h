@@ -46,6 +46,11 @@ public:
     ImportFilesCommand();
     ~ImportFilesCommand() override;
 
+    KeyCacheRequirement keyCacheRequirement() const override
+    {
+        return NoKeyCacheRequired;
+    }
+
     static const char *staticName()
     {
         return "IMPORT_FILES";
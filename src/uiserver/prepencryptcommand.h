@@ -45,6 +45,11 @@ class PrepEncryptCommand : public Kleo::AssuanCommandMixin<PrepEncryptCommand>
 public:
     PrepEncryptCommand();
     ~PrepEncryptCommand() override;
+
+    KeyCacheRequirement keyCacheRequirement() const override
+    {
+        return TargetedKeyListing;
+    }
 private:
     int doStart() override;
     void doCanceled() override;
@@ -45,6 +45,11 @@ class PrepSignCommand : public Kleo::AssuanCommandMixin<PrepSignCommand>
 public:
     PrepSignCommand();
     virtual ~PrepSignCommand();
+
+    KeyCacheRequirement keyCacheRequirement() const override
+    {
+        return TargetedKeyListing;
+    }
 private:
     int doStart() override;
     void doCanceled() override;
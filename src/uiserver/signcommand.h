@@ -46,6 +46,11 @@ public:
     SignCommand();
     ~SignCommand() override;
 
+    KeyCacheRequirement keyCacheRequirement() const override
+    {
+        return TargetedKeyListing;
+    }
+
 private:
     int doStart() override;
     void doCanceled() override;
@@ -36,10 +36,14 @@
 
 #include <crypto/signencryptfilescontroller.h>
 
+#include <utils/hex.h>
+
 #include <Libkleo/Exception>
 
 #include <KLocalizedString>
 
+#include <QThread>
+
 using namespace Kleo;
 using namespace Kleo::Crypto;
 
@@ -59,8 +63,11 @@ public:
 
 private:
     void checkForErrors() const;
+    void startController(const QStringList &files);
 
 private Q_SLOTS:
+    void slotFileListInquired(int, const QByteArray &);
+    void slotTaskCompleted(const QString &, const std::shared_ptr<const Kleo::Crypto::Task::Result> &);
     void slotDone();
     void slotError(int, const QString &);
 
@@ -79,7 +86,7 @@ SignEncryptFilesCommand::~SignEncryptFilesCommand() {}
 void SignEncryptFilesCommand::Private::checkForErrors() const
 {
 
-    if (!q->numFiles())
+    if (!q->numFiles() && !q->hasOption("batch"))
         throw Exception(makeError(GPG_ERR_ASS_NO_INPUT),
                         i18n("At least one FILE must be present"));
 
@@ -116,25 +123,74 @@ int SignEncryptFilesCommand::doStart()
 
     d->checkForErrors();
 
-    d->controller.reset(new SignEncryptFilesController(shared_from_this()));
+    // in batch mode, the files are additionally inquired, and results
+    // are reported per file as they come in
+    if (hasOption("batch")) {
+        return inquire("FILES", d.get(), SLOT(slotFileListInquired(int,QByteArray)));
+    }
+
+    d->startController(fileNames());
+
+    return 0;
+}
 
-    d->controller->setProtocol(checkProtocol(FileManager));
+void SignEncryptFilesCommand::Private::startController(const QStringList &files)
+{
+    controller.reset(new SignEncryptFilesController(q->shared_from_this()));
 
-    unsigned int op = operation();
-    if (hasOption("archive")) {
+    controller->setProtocol(q->checkProtocol(FileManager));
+
+    unsigned int op = q->operation();
+    if (q->hasOption("archive")) {
         op |= SignEncryptFilesController::ArchiveForced;
     } else {
         op |= SignEncryptFilesController::ArchiveAllowed;
     }
-    d->controller->setOperationMode(op);
-    d->controller->setFiles(fileNames());
+    controller->setOperationMode(op);
+    controller->setFiles(files);
+
+    if (q->hasOption("batch")) {
+        controller->setMaximumConcurrentTasks(QThread::idealThreadCount());
+        connect(controller.get(), &Controller::taskCompleted, this, &Private::slotTaskCompleted);
+    }
 
-    QObject::connect(d->controller.get(), SIGNAL(done()), d.get(), SLOT(slotDone()), Qt::QueuedConnection);
-    QObject::connect(d->controller.get(), SIGNAL(error(int,QString)), d.get(), SLOT(slotError(int,QString)), Qt::QueuedConnection);
+    QObject::connect(controller.get(), SIGNAL(done()), this, SLOT(slotDone()), Qt::QueuedConnection);
+    QObject::connect(controller.get(), SIGNAL(error(int,QString)), this, SLOT(slotError(int,QString)), Qt::QueuedConnection);
 
-    d->controller->start();
+    controller->start();
+}
 
-    return 0;
+void SignEncryptFilesCommand::Private::slotFileListInquired(int rc, const QByteArray &data)
+{
+    if (rc) {
+        q->done(rc);
+        return;
+    }
+
+    try {
+        const QStringList files = q->fileNames() + parseFileList(data);
+        if (files.empty())
+            throw Exception(makeError(GPG_ERR_ASS_NO_INPUT),
+                            i18n("At least one file must be given"));
+        startController(files);
+    } catch (const Exception &e) {
+        q->done(e.error(), e.message());
+    } catch (const std::exception &e) {
+        q->done(makeError(GPG_ERR_UNEXPECTED),
+                i18n("Caught unexpected exception in SignEncryptFilesCommand::Private::slotFileListInquired: %1",
+                     QString::fromLocal8Bit(e.what())));
+    } catch (...) {
+        q->done(makeError(GPG_ERR_UNEXPECTED),
+                i18n("Caught unknown exception in SignEncryptFilesCommand::Private::slotFileListInquired"));
+    }
+}
+
+void SignEncryptFilesCommand::Private::slotTaskCompleted(const QString &label, const std::shared_ptr<const Task::Result> &result)
+{
+    try {
+        q->sendStatusEncoded("FILE_DONE",
+                             std::to_string(result ? result->errorCode() : 0) + ' ' + hexencode(label.toUtf8().constData()));
+    } catch (...) {}
 }
 
 void SignEncryptFilesCommand::Private::slotDone()
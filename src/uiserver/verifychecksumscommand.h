@@ -49,6 +49,11 @@ public:
     VerifyChecksumsCommand();
     ~VerifyChecksumsCommand();
 
+    KeyCacheRequirement keyCacheRequirement() const override
+    {
+        return NoKeyCacheRequired;
+    }
+
     static const char *staticName()
     {
         return "CHECKSUM_VERIFY_FILES";
@@ -0,0 +1,105 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/assuanoptions.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+#include <config-kleopatra.h>
+
+#include "assuanoptions.h"
+
+#include "hex.h"
+
+#include <Libkleo/Exception>
+
+#include <KLocalizedString>
+
+#include <QByteArray>
+
+#include <cstring>
+
+using namespace Kleo;
+
+static void add_option(char *begin, char *end, char *lastEQ, AssuanOptions &options)
+{
+    if (begin == end) {
+        return;
+    }
+    if (begin[0] == '-' && begin[1] == '-') {
+        begin += 2;    // skip initial "--"
+    }
+    AssuanOption option;
+    option.name = begin;
+    if (lastEQ && lastEQ > begin) {
+        *lastEQ = '\0';
+        char *const valueEnd = hexdecodeInPlace(lastEQ + 1, end);
+        *valueEnd = '\0';
+        option.value = lastEQ + 1;
+    } else {
+        *end = '\0';
+        option.value = end;
+    }
+    options.append(option);
+}
+
+void Kleo::parseAssuanOptions(char *line, AssuanOptions &options)
+{
+    options.clear();
+    if (!line) {
+        return;
+    }
+    char *begin = line;
+    char *lastEQ = nullptr;
+    for (; *line; ++line) {
+        if (*line == ' ' || *line == '\t') {
+            add_option(begin, line, lastEQ, options);
+            begin = line + 1;
+            lastEQ = nullptr;
+        } else if (*line == '=') {
+            if (line == begin)
+                throw Exception(gpg_error(GPG_ERR_ASS_SYNTAX),
+                                i18n("No option name given"));
+            else {
+                lastEQ = line;
+            }
+        }
+    }
+    add_option(begin, line, lastEQ, options);
+}
+
+const AssuanOption *Kleo::findAssuanOption(const AssuanOptions &options, const char *name, bool caseSensitive)
+{
+    for (int i = options.size() - 1; i >= 0; --i) {
+        const AssuanOption &option = options[i];
+        if (caseSensitive ? std::strcmp(option.name, name) == 0 : qstricmp(option.name, name) == 0) {
+            return &option;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,66 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/assuanoptions.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+#ifndef __KLEOPATRA_UTILS_ASSUANOPTIONS_H__
+#define __KLEOPATRA_UTILS_ASSUANOPTIONS_H__
+
+#include <QVarLengthArray>
+
+namespace Kleo
+{
+
+struct AssuanOption {
+    const char *name;
+    const char *value; // empty, not null, for options without value
+};
+
+typedef QVarLengthArray<AssuanOption, 8> AssuanOptions;
+
+/*!
+  Splits an Assuan command line into options of the form
+  <tt>[--]name[=value]</tt>.
+
+  The line is parsed in place: names and (percent-decoded) values are
+  NUL-terminated inside \a line, which must therefore stay alive as
+  long as \a options is used. Later options with the same name do not
+  replace earlier ones; use findAssuanOption(), which returns the last
+  one.
+
+  Throws Kleo::Exception on syntax errors.
+*/
+void parseAssuanOptions(char *line, AssuanOptions &options);
+
+const AssuanOption *findAssuanOption(const AssuanOptions &options, const char *name, bool caseSensitive = true);
+
+}
+
+#endif /* __KLEOPATRA_UTILS_ASSUANOPTIONS_H__ */
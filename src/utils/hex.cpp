@@ -41,18 +41,56 @@
 #include <QString>
 #include <QByteArray>
 
+#include <algorithm>
+
 using namespace Kleo;
 
-static unsigned char unhex(unsigned char ch)
+namespace
 {
-    if (ch >= '0' && ch <= '9') {
-        return ch - '0';
+// -1: not a hex digit
+struct HexDecodeTable {
+    HexDecodeTable()
+    {
+        std::fill(value, value + 256, -1);
+        for (int ch = '0'; ch <= '9'; ++ch) {
+            value[ch] = ch - '0';
+        }
+        for (int ch = 'A'; ch <= 'F'; ++ch) {
+            value[ch] = value[ch - 'A' + 'a'] = ch - 'A' + 10;
+        }
     }
-    if (ch >= 'A' && ch <= 'F') {
-        return ch - 'A' + 10;
+    signed char value[256];
+};
+
+enum EncodeClass {
+    Copy,
+    Plus,
+    Escape
+};
+
+struct HexEncodeTable {
+    HexEncodeTable()
+    {
+        for (int ch = 0; ch < 256; ++ch) {
+            cls[ch] = ((ch >= '!' && ch <= '~') || ch > 0xA0) ? Copy : Plus;
+        }
+        static const char escaped[] = "\"#$%'+=";
+        for (const char *it = escaped; *it; ++it) {
+            cls[static_cast<unsigned char>(*it)] = Escape;
+        }
     }
-    if (ch >= 'a' && ch <= 'f') {
-        return ch - 'a' + 10;
+    unsigned char cls[256];
+};
+
+const HexDecodeTable decodeTable;
+const HexEncodeTable encodeTable;
+}
+
+static unsigned char unhex(unsigned char ch)
+{
+    const signed char v = decodeTable.value[ch];
+    if (v >= 0) {
+        return v;
     }
     const char cch = ch;
     throw Exception(gpg_error(GPG_ERR_ASS_SYNTAX),
@@ -60,63 +98,79 @@ static unsigned char unhex(unsigned char ch)
                          QString::fromLatin1(&cch, 1)));
 }
 
-std::string Kleo::hexdecode(const std::string &in)
+char *Kleo::hexdecodeInPlace(char *begin, char *end)
 {
-    std::string result;
-    result.reserve(in.size());
-    for (std::string::const_iterator it = in.begin(), end = in.end(); it != end; ++it)
+    // skip the prefix that needs no decoding
+    char *out = begin;
+    while (out != end && *out != '%' && *out != '+') {
+        ++out;
+    }
+    for (const char *it = out; it != end; ++it)
         if (*it == '%') {
-            ++it;
-            unsigned char ch = '\0';
-            if (it == end)
+            if (end - it < 3)
                 throw Exception(gpg_error(GPG_ERR_ASS_SYNTAX),
                                 i18n("Premature end of hex-encoded char in input stream"));
-            ch |= unhex(*it) << 4;
-            ++it;
-            if (it == end)
-                throw Exception(gpg_error(GPG_ERR_ASS_SYNTAX),
-                                i18n("Premature end of hex-encoded char in input stream"));
-            ch |= unhex(*it);
-            result.push_back(ch);
+            const unsigned char hi = unhex(it[1]);
+            const unsigned char lo = unhex(it[2]);
+            *out++ = (hi << 4) | lo;
+            it += 2;
         } else if (*it == '+') {
-            result += ' ';
-        } else  {
-            result.push_back(*it);
+            *out++ = ' ';
+        } else {
+            *out++ = *it;
         }
-    return result;
+    return out;
 }
 
-std::string Kleo::hexencode(const std::string &in)
+static size_t hexencoded_size(const char *begin, const char *end)
 {
-    std::string result;
-    result.reserve(3 * in.size());
+    size_t size = end - begin;
+    for (const char *it = begin; it != end; ++it)
+        if (encodeTable.cls[static_cast<unsigned char>(*it)] == Escape) {
+            size += 2;
+        }
+    return size;
+}
 
+static void hexencode_to(const char *begin, const char *end, char *out)
+{
     static const char hex[] = "0123456789ABCDEF";
 
-    for (std::string::const_iterator it = in.begin(), end = in.end(); it != end; ++it)
-        switch (const unsigned char ch = *it) {
-        default:
-            if ((ch >= '!' && ch <= '~') || ch > 0xA0) {
-                result += ch;
-                break;
-            }
-        // else fall through
-        case ' ':
-            result += '+';
+    for (const char *it = begin; it != end; ++it) {
+        const unsigned char ch = *it;
+        switch (encodeTable.cls[ch]) {
+        case Copy:
+            *out++ = ch;
             break;
-        case '"':
-        case '#':
-        case '$':
-        case '%':
-        case '\'':
-        case '+':
-        case '=':
-            result += '%';
-            result += hex[(ch & 0xF0) >> 4 ];
-            result += hex[(ch & 0x0F)      ];
+        case Plus:
+            *out++ = '+';
+            break;
+        case Escape:
+            *out++ = '%';
+            *out++ = hex[(ch & 0xF0) >> 4 ];
+            *out++ = hex[(ch & 0x0F)      ];
             break;
         }
+    }
+}
 
+std::string Kleo::hexdecode(const std::string &in)
+{
+    std::string result = in;
+    if (!result.empty()) {
+        char *const begin = &result[0];
+        result.resize(hexdecodeInPlace(begin, begin + result.size()) - begin);
+    }
+    return result;
+}
+
+std::string Kleo::hexencode(const std::string &in)
+{
+    const char *const begin = in.data(), *const end = begin + in.size();
+    std::string result(hexencoded_size(begin, end), '\0');
+    if (!result.empty()) {
+        hexencode_to(begin, end, &result[0]);
+    }
     return result;
 }
 
@@ -141,8 +195,10 @@ QByteArray Kleo::hexdecode(const QByteArray &in)
     if (in.isNull()) {
         return QByteArray();
     }
-    const std::string result = hexdecode(std::string(in.constData()));
-    return QByteArray(result.data(), result.size());
+    QByteArray result = in;
+    char *const begin = result.data();
+    result.truncate(hexdecodeInPlace(begin, begin + result.size()) - begin);
+    return result;
 }
 
 QByteArray Kleo::hexencode(const QByteArray &in)
@@ -150,6 +206,8 @@ QByteArray Kleo::hexencode(const QByteArray &in)
     if (in.isNull()) {
         return QByteArray();
     }
-    const std::string result = hexencode(std::string(in.constData()));
-    return QByteArray(result.data(), result.size());
+    const char *const begin = in.constData(), *const end = begin + in.size();
+    QByteArray result(hexencoded_size(begin, end), Qt::Uninitialized);
+    hexencode_to(begin, end, result.data());
+    return result;
 }
@@ -49,6 +49,9 @@ std::string hexdecode(const std::string &s);
 QByteArray hexencode(const QByteArray &s);
 QByteArray hexdecode(const QByteArray &s);
 
+// decodes [begin,end) in place, returns the new end
+char *hexdecodeInPlace(char *begin, char *end);
+
 }
 
 #endif /* __KLEOPATRA_UTILS_HEX_H__ */
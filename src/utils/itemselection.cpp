@@ -0,0 +1,71 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/itemselection.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+
+#include <config-kleopatra.h>
+
+#include "itemselection.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+QItemSelection Kleo::rowSelectionFromIndexes(const QModelIndexList &indexes)
+{
+    // (parent, row), so that the rows of each parent end up next to each other:
+    std::vector<std::pair<QModelIndex, int>> rows;
+    rows.reserve(indexes.size());
+    const QAbstractItemModel *model = nullptr;
+    for (const QModelIndex &idx : indexes) {
+        if (idx.isValid()) {
+            rows.emplace_back(idx.parent(), idx.row());
+            model = idx.model();
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+
+    QItemSelection result;
+    result.reserve(static_cast<int>(rows.size()));
+    auto it = rows.cbegin();
+    const auto end = rows.cend();
+    while (it != end) {
+        const QModelIndex parent = it->first;
+        const int first = it->second;
+        int last = first;
+        for (++it; it != end && it->first == parent && it->second <= last + 1; ++it) {
+            last = it->second;
+        }
+        result.append(QItemSelectionRange(model->index(first, 0, parent), model->index(last, 0, parent)));
+    }
+    return result;
+}
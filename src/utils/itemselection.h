@@ -0,0 +1,56 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/itemselection.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+
+#ifndef __KLEOPATRA_UTILS_ITEMSELECTION_H__
+#define __KLEOPATRA_UTILS_ITEMSELECTION_H__
+
+#include <QItemSelection>
+#include <QModelIndexList>
+
+namespace Kleo
+{
+
+/*!
+  Returns a selection of the rows of \a indexes in which each run of
+  adjacent rows under the same parent is a single range, so that
+  selecting many rows at once does not hand the selection model one
+  range per row. Invalid and duplicate indexes are skipped; the
+  ranges cover column 0, so select them with
+  QItemSelectionModel::Rows.
+*/
+QItemSelection rowSelectionFromIndexes(const QModelIndexList &indexes);
+
+}
+
+#endif /* __KLEOPATRA_UTILS_ITEMSELECTION_H__ */
@@ -21,6 +21,7 @@
 
 #include "kdpipeiodevice.h"
 
+#include <QAtomicInteger>
 #include <QDebug>
 #include <QMutex>
 #include <QPointer>
@@ -242,6 +243,8 @@ private:
     Writer *writer;
     bool triedToStartReader;
     bool triedToStartWriter;
+    // written from the thread calling writeData(), read from anywhere:
+    QAtomicInteger<qint64> totalBytesWritten;
 };
 
 KDPipeIODevice::DebugLevel KDPipeIODevice::debugLevel()
@@ -260,7 +263,8 @@ KDPipeIODevice::Private::Private(KDPipeIODevice *qq) : QObject(qq), q(qq),
     reader(nullptr),
     writer(nullptr),
     triedToStartReader(false),
-    triedToStartWriter(false)
+    triedToStartWriter(false),
+    totalBytesWritten(0)
 {
 
 }
@@ -691,7 +695,17 @@ qint64 KDPipeIODevice::writeData(const char *data, qint64 size)
 
     Q_ASSERT(w->bufferEmpty());
 
-    return w->writeData(data, size);
+    const qint64 written = w->writeData(data, size);
+    if (written > 0) {
+        d->totalBytesWritten.fetchAndAddRelaxed(written);
+    }
+    return written;
+}
+
+qint64 KDPipeIODevice::totalBytesWritten() const
+{
+    KDAB_CHECK_THIS;
+    return d->totalBytesWritten.loadAcquire();
 }
 
 qint64 Writer::writeData(const char *data, qint64 size)
@@ -55,6 +55,7 @@ public:
 
     qint64 bytesAvailable() const override;
     qint64 bytesToWrite() const override;
+    qint64 totalBytesWritten() const;
     bool canReadLine() const override;
     void close() override;
     bool isSequential() const override;
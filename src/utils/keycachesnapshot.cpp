@@ -0,0 +1,383 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keycachesnapshot.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+#include <config-kleopatra.h>
+
+#include "keycachesnapshot.h"
+
+#include <utils/gnupg-helper.h>
+
+#include <Libkleo/Formatting>
+
+#include <gpgme++/key.h>
+
+#include "kleopatra_debug.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+
+#include <cstring>
+
+using namespace Kleo;
+
+namespace
+{
+static const char SNAPSHOT_MAGIC[8] = { 'K', 'L', 'E', 'O', 'K', 'C', 'S', 'S' };
+static const quint32 SNAPSHOT_VERSION = 1;
+static const quint32 SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;      // SNAPSHOT_BYTE_ORDER, as written
+    quint32 count;          // number of Records following the Header
+    quint32 stringsOffset;  // UTF-8 string table, after the Records
+    quint32 stringsSize;
+    quint32 reserved;
+    char stamp[20];         // see keyring_stamp()
+};
+
+struct Record {
+    char fingerprint[64];   // NUL-padded
+    quint32 nameOffset;     // relative to stringsOffset
+    quint32 nameLength;
+    quint32 emailOffset;
+    quint32 emailLength;
+    qint64 expiration;
+    quint8 protocol;
+    quint8 validity;
+    quint8 capabilities;
+    quint8 reserved[5];
+};
+}
+
+// A SHA-1 over name, size and mtime of everything the key listing
+// depends on.
+static QByteArray keyring_stamp()
+{
+    static const char *const files[] = {
+        "pubring.kbx",
+        "pubring.gpg",
+        "trustdb.gpg",
+        "trustlist.txt",
+        "private-keys-v1.d",
+    };
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const QDir homeDir(gnupgHomeDirectory());
+    for (const char *file : files) {
+        const QFileInfo fi(homeDir.absoluteFilePath(QLatin1String(file)));
+        hash.addData(file);
+        if (fi.exists()) {
+            hash.addData(QByteArray::number(fi.size()));
+            hash.addData(QByteArray::number(fi.lastModified().toMSecsSinceEpoch()));
+        }
+    }
+    return hash.result();
+}
+
+static unsigned int capabilities(const GpgME::Key &key)
+{
+    unsigned int caps = 0;
+    if (key.canEncrypt()) {
+        caps |= KeyCacheSnapshot::CanEncrypt;
+    }
+    if (key.canSign()) {
+        caps |= KeyCacheSnapshot::CanSign;
+    }
+    if (key.canCertify()) {
+        caps |= KeyCacheSnapshot::CanCertify;
+    }
+    if (key.canAuthenticate()) {
+        caps |= KeyCacheSnapshot::CanAuthenticate;
+    }
+    if (key.hasSecret()) {
+        caps |= KeyCacheSnapshot::HasSecret;
+    }
+    if (key.isRevoked()) {
+        caps |= KeyCacheSnapshot::IsRevoked;
+    }
+    if (key.isExpired()) {
+        caps |= KeyCacheSnapshot::IsExpired;
+    }
+    if (key.isDisabled()) {
+        caps |= KeyCacheSnapshot::IsDisabled;
+    }
+    return caps;
+}
+
+class KeyCacheSnapshot::Private
+{
+    friend class ::Kleo::KeyCacheSnapshot;
+public:
+    Private() : data(nullptr), size(0), count(0), stringsOffset(0), stringsSize(0) {}
+
+private:
+    void close()
+    {
+        if (data) {
+            file.unmap(data);
+        }
+        file.close();
+        data = nullptr;
+        size = count = stringsOffset = stringsSize = 0;
+    }
+
+    QString string(quint32 offset, quint32 length) const
+    {
+        if (offset > stringsSize || length > stringsSize - offset) {
+            return QString();
+        }
+        return QString::fromUtf8(reinterpret_cast<const char *>(data) + stringsOffset + offset, length);
+    }
+
+private:
+    QFile file;
+    uchar *data;
+    quint64 size;
+    quint32 count;
+    quint32 stringsOffset;
+    quint32 stringsSize;
+};
+
+KeyCacheSnapshot::KeyCacheSnapshot()
+    : d(new Private)
+{
+
+}
+
+KeyCacheSnapshot::~KeyCacheSnapshot()
+{
+    d->close();
+}
+
+QString KeyCacheSnapshot::fileName()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).absoluteFilePath(QStringLiteral("keycache.snapshot"));
+}
+
+bool KeyCacheSnapshot::load()
+{
+    d->close();
+
+    d->file.setFileName(fileName());
+    if (!d->file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const qint64 size = d->file.size();
+    if (size < static_cast<qint64>(sizeof(Header))) {
+        d->close();
+        return false;
+    }
+    d->data = d->file.map(0, size);
+    if (!d->data) {
+        d->close();
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, d->data, sizeof header);
+    const quint64 recordsEnd = sizeof(Header) + quint64(header.count) * sizeof(Record);
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC) != 0
+            || header.version != SNAPSHOT_VERSION
+            || header.byteOrder != SNAPSHOT_BYTE_ORDER
+            || recordsEnd > quint64(size)
+            || header.stringsOffset < recordsEnd
+            || quint64(header.stringsOffset) + header.stringsSize > quint64(size)) {
+        qCDebug(KLEOPATRA_LOG) << "KeyCacheSnapshot: ignoring invalid snapshot" << fileName();
+        d->close();
+        return false;
+    }
+    if (QByteArray(header.stamp, sizeof header.stamp) != keyring_stamp()) {
+        qCDebug(KLEOPATRA_LOG) << "KeyCacheSnapshot: keyrings changed, ignoring snapshot";
+        d->close();
+        return false;
+    }
+
+    d->size = size;
+    d->count = header.count;
+    d->stringsOffset = header.stringsOffset;
+    d->stringsSize = header.stringsSize;
+    return true;
+}
+
+bool KeyCacheSnapshot::isValid() const
+{
+    return d->data != nullptr;
+}
+
+unsigned int KeyCacheSnapshot::size() const
+{
+    return d->count;
+}
+
+KeyCacheSnapshot::Entry KeyCacheSnapshot::entry(unsigned int idx) const
+{
+    Entry e = { QByteArray(), GpgME::UnknownProtocol, QString(), QString(), 0, 0, 0 };
+    if (idx >= d->count) {
+        return e;
+    }
+    Record r;
+    std::memcpy(&r, d->data + sizeof(Header) + quint64(idx) * sizeof(Record), sizeof r);
+    e.fingerprint = QByteArray(r.fingerprint, qstrnlen(r.fingerprint, sizeof r.fingerprint));
+    e.protocol = static_cast<GpgME::Protocol>(r.protocol);
+    e.name = d->string(r.nameOffset, r.nameLength);
+    e.email = d->string(r.emailOffset, r.emailLength);
+    e.validity = r.validity;
+    e.expiration = r.expiration;
+    e.capabilities = r.capabilities;
+    return e;
+}
+
+// Formats \a keys into the contents of a snapshot file.
+static QByteArray build_snapshot(const std::vector<GpgME::Key> &keys, const QByteArray &stamp)
+{
+    Header header;
+    std::memset(&header, 0, sizeof header);
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC);
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.count = keys.size();
+    header.stringsOffset = sizeof(Header) + keys.size() * sizeof(Record);
+    std::memcpy(header.stamp, stamp.constData(), qMin<int>(stamp.size(), sizeof header.stamp));
+
+    QByteArray records;
+    records.reserve(keys.size() * sizeof(Record));
+    QByteArray strings;
+    const auto addString = [&strings](const QString &str, quint32 &offset, quint32 &length) {
+        const QByteArray utf8 = str.toUtf8();
+        offset = strings.size();
+        length = utf8.size();
+        strings += utf8;
+    };
+
+    for (const GpgME::Key &key : keys) {
+        Record r;
+        std::memset(&r, 0, sizeof r);
+        if (const char *fpr = key.primaryFingerprint()) {
+            std::strncpy(r.fingerprint, fpr, sizeof r.fingerprint);
+        }
+        addString(Formatting::prettyName(key), r.nameOffset, r.nameLength);
+        addString(Formatting::prettyEMail(key), r.emailOffset, r.emailLength);
+        const GpgME::Subkey subkey = key.subkey(0);
+        r.expiration = subkey.neverExpires() ? 0 : static_cast<qint64>(subkey.expirationTime());
+        r.protocol = key.protocol();
+        r.validity = key.userID(0).validity();
+        r.capabilities = capabilities(key);
+        records.append(reinterpret_cast<const char *>(&r), sizeof r);
+    }
+    header.stringsSize = strings.size();
+
+    QByteArray data;
+    data.reserve(sizeof header + records.size() + strings.size());
+    data.append(reinterpret_cast<const char *>(&header), sizeof header);
+    data += records;
+    data += strings;
+    return data;
+}
+
+// The stamp of the snapshot on disk, or an empty QByteArray.
+static QByteArray written_stamp()
+{
+    QFile file(KeyCacheSnapshot::fileName());
+    Header header;
+    if (!file.open(QIODevice::ReadOnly)
+            || file.read(reinterpret_cast<char *>(&header), sizeof header) != sizeof header
+            || std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof SNAPSHOT_MAGIC) != 0
+            || header.version != SNAPSHOT_VERSION
+            || header.byteOrder != SNAPSHOT_BYTE_ORDER) {
+        return QByteArray();
+    }
+    return QByteArray(header.stamp, sizeof header.stamp);
+}
+
+namespace
+{
+// Only the most recent snapshot is of interest; writers take it from here.
+QMutex pendingMutex;
+QByteArray pendingSnapshot;
+// serializes the writers, so that an older snapshot can't overwrite a newer one
+QMutex writeMutex;
+
+class SnapshotWriter : public QRunnable
+{
+public:
+    void run() override
+    {
+        const QMutexLocker writeLocker(&writeMutex);
+        QByteArray data;
+        {
+            const QMutexLocker locker(&pendingMutex);
+            data.swap(pendingSnapshot);
+        }
+        if (data.isEmpty()) {
+            return; // a later writer got here first
+        }
+
+        const QString fn = KeyCacheSnapshot::fileName();
+        QDir().mkpath(QFileInfo(fn).absolutePath());
+        QSaveFile file(fn);
+        if (!file.open(QIODevice::WriteOnly)
+                || file.write(data) != data.size()
+                || !file.commit()) {
+            qCDebug(KLEOPATRA_LOG) << "KeyCacheSnapshot: could not write" << fn << ":" << file.errorString();
+        }
+    }
+};
+}
+
+void KeyCacheSnapshot::write(const std::vector<GpgME::Key> &keys)
+{
+    // only called from the GUI thread:
+    static QByteArray lastStamp = written_stamp();
+
+    const QByteArray stamp = keyring_stamp();
+    if (stamp == lastStamp) {
+        return;
+    }
+    lastStamp = stamp;
+
+    const QByteArray data = build_snapshot(keys, stamp);
+    {
+        const QMutexLocker locker(&pendingMutex);
+        pendingSnapshot = data;
+    }
+    QThreadPool::globalInstance()->start(new SnapshotWriter);
+}
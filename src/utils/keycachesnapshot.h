@@ -0,0 +1,113 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keycachesnapshot.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+#ifndef __KLEOPATRA_UTILS_KEYCACHESNAPSHOT_H__
+#define __KLEOPATRA_UTILS_KEYCACHESNAPSHOT_H__
+
+#include <utils/pimpl_ptr.h>
+
+#include <gpgme++/global.h>
+
+#include <QString>
+
+#include <vector>
+
+namespace GpgME
+{
+class Key;
+}
+
+namespace Kleo
+{
+
+/*!
+  \brief A compact on-disk copy of the last complete key listing
+
+  The snapshot stores, per certificate, what the key list shows at a
+  glance: fingerprint, protocol, name, e-mail, validity, expiration
+  and capabilities. The file is memory-mapped and entries are decoded
+  on access, so opening a snapshot of tens of thousands of
+  certificates takes milliseconds.
+
+  A snapshot is only valid as long as the keyrings it was made from
+  didn't change (size and mtime of the keybox, keyring and trustdb
+  files); load() refuses stale ones.
+*/
+class KeyCacheSnapshot
+{
+public:
+    enum Capability {
+        CanEncrypt      = 0x01,
+        CanSign         = 0x02,
+        CanCertify      = 0x04,
+        CanAuthenticate = 0x08,
+        HasSecret       = 0x10,
+        IsRevoked       = 0x20,
+        IsExpired       = 0x40,
+        IsDisabled      = 0x80
+    };
+
+    struct Entry {
+        QByteArray fingerprint;
+        GpgME::Protocol protocol;
+        QString name;
+        QString email;
+        int validity;        // GpgME::UserID::Validity of the primary user ID
+        qint64 expiration;   // 0 = never
+        unsigned int capabilities;
+    };
+
+    KeyCacheSnapshot();
+    ~KeyCacheSnapshot();
+
+    bool load();
+    bool isValid() const;
+
+    unsigned int size() const;
+    Entry entry(unsigned int idx) const;
+
+    static QString fileName();
+    /*!
+      Writes a snapshot of \a keys, unless the keyrings didn't change
+      since the last one. The records are built in the calling (GUI)
+      thread; the file is written in a background thread.
+    */
+    static void write(const std::vector<GpgME::Key> &keys);
+
+private:
+    class Private;
+    kdtools::pimpl_ptr<Private> d;
+};
+
+}
+
+#endif /* __KLEOPATRA_UTILS_KEYCACHESNAPSHOT_H__ */
@@ -0,0 +1,392 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keydisplaycache.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+
+#include <config-kleopatra.h>
+
+#include "keydisplaycache.h"
+
+#include <Libkleo/KeyCache>
+#include <Libkleo/KeyListModel>
+
+#include <gpgme++/key.h>
+
+#include <QCache>
+#include <QHash>
+#include <QTimer>
+
+#include <algorithm>
+#include <limits>
+
+using namespace Kleo;
+using namespace GpgME;
+
+namespace
+{
+
+// The columns whose texts only depend on the key. (The remarks also
+// depend on the remark keys of the model.)
+const int cachedColumns[] = {
+    KeyListModelInterface::PrettyName,
+    KeyListModelInterface::PrettyEMail,
+    KeyListModelInterface::Validity,
+    KeyListModelInterface::ValidFrom,
+    KeyListModelInterface::ValidUntil,
+    KeyListModelInterface::TechnicalDetails,
+    KeyListModelInterface::KeyID,
+    KeyListModelInterface::Fingerprint,
+    KeyListModelInterface::OwnerTrust,
+    KeyListModelInterface::Origin,
+    KeyListModelInterface::LastUpdate,
+    KeyListModelInterface::Issuer,
+    KeyListModelInterface::SerialNumber,
+};
+
+const int cachedRoles[] = {
+    Qt::DisplayRole,
+    Qt::EditRole,
+    Qt::ToolTipRole,
+    Qt::AccessibleTextRole,
+};
+const int numCachedRoles = sizeof cachedRoles / sizeof *cachedRoles;
+
+// The texts kept, over all keys, are bounded by the display texts of
+// the columns in use for every key in the KeyCache, plus this many for
+// the other roles and columns; the least recently used keys are dropped
+// first. It is also the bound before the first key listing.
+const int MAX_CACHED_VALUES = 200000;
+
+// the number of keys prefetched per pass of the event loop
+const unsigned int PREFETCH_BATCH_SIZE = 100;
+
+int role_index(int role)
+{
+    const auto it = std::find(std::begin(cachedRoles), std::end(cachedRoles), role);
+    return it == std::end(cachedRoles) ? -1 : static_cast<int>(it - std::begin(cachedRoles));
+}
+
+int slot(int column, int role)
+{
+    return column * numCachedRoles + role_index(role);
+}
+
+// the columns the views looked at before the first prefetch:
+const quint32 defaultColumnsInUse = (1u << KeyListModelInterface::PrettyName)
+                                    | (1u << KeyListModelInterface::PrettyEMail)
+                                    | (1u << KeyListModelInterface::Validity)
+                                    | (1u << KeyListModelInterface::ValidFrom)
+                                    | (1u << KeyListModelInterface::ValidUntil)
+                                    | (1u << KeyListModelInterface::KeyID);
+
+}
+
+class KeyDisplayCache::Private
+{
+    friend class ::Kleo::KeyDisplayCache;
+    KeyDisplayCache *const q;
+public:
+    explicit Private(KeyDisplayCache *qq);
+
+private:
+    void insert(const Key &key, int slot, const QVariant &value);
+    void updateMaxCost();
+    void clear();
+    void startPrefetch();
+    void prefetchSome();
+
+private:
+    struct Entry {
+        Key key;   // keeps the key object, and thus its address, alive
+        QHash<int, QVariant> values;
+    };
+    // by key object, so that updated keys miss; the cost of an entry is
+    // the number of its values
+    QCache<const void *, Entry> entries;
+    int toolTipOptions;
+    quint32 columnsInUse;
+    // the number of keys in the KeyCache at the last key listing
+    size_t numKeys;
+
+    // The keys whose display texts are still to be prefetched. The texts
+    // are formatted by a model, exactly like the models of the views do,
+    // in small batches whenever the event loop is idle. (Formatting goes
+    // through process-wide state like the CryptoConfig, so this has to
+    // happen in the GUI thread.)
+    std::vector<Key> prefetchKeys;
+    size_t prefetchPos;
+    std::vector<int> prefetchColumns;
+    std::unique_ptr<AbstractKeyListModel> prefetchModel;
+    QTimer prefetchTimer;
+};
+
+KeyDisplayCache::Private::Private(KeyDisplayCache *qq)
+    : q(qq),
+      entries(MAX_CACHED_VALUES),
+      toolTipOptions(0),
+      columnsInUse(defaultColumnsInUse),
+      numKeys(0),
+      prefetchKeys(),
+      prefetchPos(0),
+      prefetchColumns(),
+      prefetchModel(),
+      prefetchTimer()
+{
+    prefetchTimer.setSingleShot(true);
+    prefetchTimer.setInterval(0);
+    QObject::connect(&prefetchTimer, &QTimer::timeout, q, [this]() { prefetchSome(); });
+
+    const std::shared_ptr<const KeyCache> cache = KeyCache::instance();
+    QObject::connect(cache.get(), &KeyCache::keyListingDone, q, [this]() { startPrefetch(); });
+    QObject::connect(cache.get(), &KeyCache::aboutToRemove, q, [this](const Key &key) { entries.remove(key.impl()); });
+    if (cache->initialized()) {
+        startPrefetch();
+    }
+}
+
+void KeyDisplayCache::Private::insert(const Key &key, int slot, const QVariant &value)
+{
+    // QCache only learns about the new cost on (re-)insertion
+    Entry *entry = entries.take(key.impl());
+    if (!entry) {
+        entry = new Entry{ key, QHash<int, QVariant>() };
+    }
+    entry->values.insert(slot, value);
+    entries.insert(key.impl(), entry, entry->values.size());
+}
+
+void KeyDisplayCache::Private::updateMaxCost()
+{
+    int columns = 0;
+    for (const int column : cachedColumns) {
+        if (columnsInUse & (1u << column)) {
+            ++columns;
+        }
+    }
+    const qint64 cost = qint64(numKeys) * columns + MAX_CACHED_VALUES;
+    entries.setMaxCost(int(std::min<qint64>(cost, std::numeric_limits<int>::max())));
+}
+
+void KeyDisplayCache::Private::clear()
+{
+    entries.clear();
+    if (KeyCache::instance()->initialized()) {
+        startPrefetch();
+    }
+}
+
+void KeyDisplayCache::Private::startPrefetch()
+{
+    prefetchKeys = KeyCache::instance()->keys();
+    prefetchPos = 0;
+    prefetchColumns.clear();
+    for (const int column : cachedColumns) {
+        if (columnsInUse & (1u << column)) {
+            prefetchColumns.push_back(column);
+        }
+    }
+    numKeys = prefetchKeys.size();
+    updateMaxCost();
+    if (!prefetchModel) {
+        prefetchModel.reset(AbstractKeyListModel::createFlatKeyListModel());
+    }
+    prefetchTimer.start();
+}
+
+void KeyDisplayCache::Private::prefetchSome()
+{
+    const size_t end = std::min(prefetchKeys.size(), prefetchPos + PREFETCH_BATCH_SIZE);
+    prefetchModel->setKeys(std::vector<Key>(prefetchKeys.begin() + prefetchPos, prefetchKeys.begin() + end));
+    prefetchPos = end;
+
+    for (int row = 0, rows = prefetchModel->rowCount(); row < rows; ++row) {
+        const Key key = prefetchModel->key(prefetchModel->index(row, 0));
+        if (key.isNull() || !key.impl()) {
+            continue;
+        }
+        for (const int column : prefetchColumns) {
+            insert(key, slot(column, Qt::DisplayRole), prefetchModel->data(prefetchModel->index(row, column), Qt::DisplayRole));
+        }
+    }
+
+    // stop once the cache would start to drop what we prefetched:
+    const bool full = entries.totalCost() + int(PREFETCH_BATCH_SIZE * prefetchColumns.size()) > entries.maxCost();
+    if (prefetchPos < prefetchKeys.size() && !full) {
+        prefetchTimer.start();
+    } else {
+        prefetchKeys.clear();
+        prefetchKeys.shrink_to_fit();
+        prefetchModel.reset();
+    }
+}
+
+KeyDisplayCache::KeyDisplayCache()
+    : QObject(), d(new Private(this))
+{
+}
+
+KeyDisplayCache::~KeyDisplayCache() {}
+
+// static
+std::shared_ptr<KeyDisplayCache> KeyDisplayCache::instance()
+{
+    static std::weak_ptr<KeyDisplayCache> self;
+    try {
+        return std::shared_ptr<KeyDisplayCache>(self);
+    } catch (const std::bad_weak_ptr &) {
+        const std::shared_ptr<KeyDisplayCache> s(new KeyDisplayCache);
+        self = s;
+        return s;
+    }
+}
+
+// static
+bool KeyDisplayCache::isCached(int column, int role)
+{
+    return role_index(role) >= 0
+           && std::find(std::begin(cachedColumns), std::end(cachedColumns), column) != std::end(cachedColumns);
+}
+
+bool KeyDisplayCache::find(const Key &key, int column, int role, QVariant *value) const
+{
+    const Private::Entry *const entry = d->entries.object(key.impl());
+    if (!entry) {
+        return false;
+    }
+    const auto it = entry->values.constFind(slot(column, role));
+    if (it == entry->values.constEnd()) {
+        return false;
+    }
+    *value = it.value();
+    return true;
+}
+
+void KeyDisplayCache::insert(const Key &key, int column, int role, const QVariant &value)
+{
+    if (!key.impl() || !isCached(column, role)) {
+        return;
+    }
+    if (role == Qt::DisplayRole && !(d->columnsInUse & (1u << column))) {
+        d->columnsInUse |= 1u << column;
+        d->updateMaxCost();
+    }
+    d->insert(key, slot(column, role), value);
+}
+
+void KeyDisplayCache::setToolTipOptions(int options)
+{
+    if (options != d->toolTipOptions) {
+        d->toolTipOptions = options;
+        d->clear();
+    }
+}
+
+int KeyDisplayCache::toolTipOptions() const
+{
+    return d->toolTipOptions;
+}
+
+void KeyDisplayCache::invalidate()
+{
+    d->clear();
+}
+
+KeyDisplayCacheProxyModel::KeyDisplayCacheProxyModel(QObject *parent)
+    : QIdentityProxyModel(parent),
+      m_cache(KeyDisplayCache::instance()),
+      m_source(nullptr),
+      m_model(nullptr)
+{
+}
+
+KeyDisplayCacheProxyModel::~KeyDisplayCacheProxyModel() {}
+
+void KeyDisplayCacheProxyModel::setSourceModel(QAbstractItemModel *model)
+{
+    m_source = dynamic_cast<const KeyListModelInterface *>(model);
+    m_model = dynamic_cast<const AbstractKeyListModel *>(model);
+    QIdentityProxyModel::setSourceModel(model);
+}
+
+QVariant KeyDisplayCacheProxyModel::data(const QModelIndex &index, int role) const
+{
+    if (!m_source || !KeyDisplayCache::isCached(index.column(), role)
+        || (role == Qt::ToolTipRole && (!m_model || m_model->toolTipOptions() != m_cache->toolTipOptions()))) {
+        return QIdentityProxyModel::data(index, role);
+    }
+    const Key key = m_source->key(mapToSource(index));
+    QVariant value;
+    if (key.isNull() || !m_cache->find(key, index.column(), role, &value)) {
+        value = QIdentityProxyModel::data(index, role);
+        if (!key.isNull()) {
+            m_cache->insert(key, index.column(), role, value);
+        }
+    }
+    return value;
+}
+
+Key KeyDisplayCacheProxyModel::key(const QModelIndex &index) const
+{
+    return m_source ? m_source->key(mapToSource(index)) : Key();
+}
+
+std::vector<Key> KeyDisplayCacheProxyModel::keys(const QList<QModelIndex> &indexes) const
+{
+    if (!m_source) {
+        return std::vector<Key>();
+    }
+    QList<QModelIndex> sourceIndexes;
+    sourceIndexes.reserve(indexes.size());
+    for (const QModelIndex &idx : indexes) {
+        sourceIndexes.push_back(mapToSource(idx));
+    }
+    return m_source->keys(sourceIndexes);
+}
+
+QModelIndex KeyDisplayCacheProxyModel::index(const Key &key) const
+{
+    return m_source ? mapFromSource(m_source->index(key)) : QModelIndex();
+}
+
+QList<QModelIndex> KeyDisplayCacheProxyModel::indexes(const std::vector<Key> &keys) const
+{
+    QList<QModelIndex> result;
+    if (!m_source) {
+        return result;
+    }
+    const QList<QModelIndex> sourceIndexes = m_source->indexes(keys);
+    result.reserve(sourceIndexes.size());
+    for (const QModelIndex &idx : sourceIndexes) {
+        result.push_back(mapFromSource(idx));
+    }
+    return result;
+}
@@ -0,0 +1,132 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keydisplaycache.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+
+#ifndef __KLEOPATRA_UTILS_KEYDISPLAYCACHE_H__
+#define __KLEOPATRA_UTILS_KEYDISPLAYCACHE_H__
+
+#include <QIdentityProxyModel>
+#include <QObject>
+
+#include <Libkleo/KeyListModel>
+
+#include <utils/pimpl_ptr.h>
+
+#include <memory>
+#include <vector>
+
+namespace GpgME
+{
+class Key;
+}
+
+namespace Kleo
+{
+
+/*!
+  \brief Remembers the texts the key list models show for each key
+
+  The texts (display, edit, tool tip and accessible texts of the
+  columns that only depend on the key itself) are cached per key
+  object: a key updated by the KeyCache is a new object, and so gets
+  new texts. Configuration changes that affect the texts drop the
+  whole cache. The number of cached texts is bounded, but large enough
+  for the display texts of the columns in use for every key of the
+  KeyCache; beyond that, the texts of the least recently used keys are
+  dropped first.
+
+  After each key listing, the display texts of the columns in use are
+  computed in small batches while the event loop is idle, so that
+  neither painting nor sorting the views needs to format anything.
+*/
+class KeyDisplayCache : public QObject
+{
+    Q_OBJECT
+public:
+    ~KeyDisplayCache();
+
+    static std::shared_ptr<KeyDisplayCache> instance();
+
+    //! Returns whether \a role of \a column is cached at all.
+    static bool isCached(int column, int role);
+
+    bool find(const GpgME::Key &key, int column, int role, QVariant *value) const;
+    void insert(const GpgME::Key &key, int column, int role, const QVariant &value);
+
+    //! The tool tips depend on these; changing them drops the cache.
+    void setToolTipOptions(int options);
+    int toolTipOptions() const;
+    //! Drops the cache, e.g. after a configuration change.
+    void invalidate();
+
+private:
+    KeyDisplayCache();
+
+private:
+    class Private;
+    kdtools::pimpl_ptr<Private> d;
+};
+
+/*!
+  \brief Answers the cached roles of a key list model from the KeyDisplayCache
+
+  Put it between a key list model and the proxies (or view) on top of
+  it. The tool tips are only taken from the cache if the model uses
+  the same tool tip options as the cache.
+*/
+class KeyDisplayCacheProxyModel : public QIdentityProxyModel, public KeyListModelInterface
+{
+    Q_OBJECT
+public:
+    explicit KeyDisplayCacheProxyModel(QObject *parent = nullptr);
+    ~KeyDisplayCacheProxyModel();
+
+    void setSourceModel(QAbstractItemModel *model) override;
+    QVariant data(const QModelIndex &index, int role) const override;
+
+    using QIdentityProxyModel::index;
+
+    GpgME::Key key(const QModelIndex &index) const override;
+    std::vector<GpgME::Key> keys(const QList<QModelIndex> &indexes) const override;
+    QModelIndex index(const GpgME::Key &key) const override;
+    QList<QModelIndex> indexes(const std::vector<GpgME::Key> &keys) const override;
+
+private:
+    const std::shared_ptr<KeyDisplayCache> m_cache;
+    const KeyListModelInterface *m_source;
+    const AbstractKeyListModel *m_model;
+};
+
+}
+
+#endif /* __KLEOPATRA_UTILS_KEYDISPLAYCACHE_H__ */
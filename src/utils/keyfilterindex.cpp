@@ -0,0 +1,201 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keyfilterindex.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+#include <config-kleopatra.h>
+
+#include "keyfilterindex.h"
+
+#include <Libkleo/DefaultKeyFilter>
+#include <Libkleo/KeyCache>
+
+#include <gpgme++/key.h>
+
+#include "kleopatra_debug.h"
+
+#include <QByteArray>
+#include <QHash>
+
+#include <map>
+
+using namespace Kleo;
+using namespace GpgME;
+
+// one bit per filter:
+static const unsigned int MAX_INDEXED_FILTERS = 64;
+
+class KeyFilterIndex::Private
+{
+    friend class ::Kleo::KeyFilterIndex;
+    KeyFilterIndex *const q;
+public:
+    explicit Private(KeyFilterIndex *qq);
+
+    class IndexedFilter;
+
+    bool matches(unsigned int slot, const KeyFilter &filter, const Key &key);
+    void releaseSlot(unsigned int slot);
+
+private:
+    struct Bits {
+        Bits() : evaluated(0), matched(0) {}
+        quint64 evaluated;
+        quint64 matched;
+    };
+    QHash<QByteArray, Bits> bitsByFingerprint;
+    quint64 usedSlots;
+    std::map<const KeyFilter *, std::weak_ptr<KeyFilter>> indexedFilters;
+};
+
+// Stands in for a KeyFilter on the proxy models. Apart from the
+// matching, only what the proxies and tab pages look at is copied.
+class KeyFilterIndex::Private::IndexedFilter : public DefaultKeyFilter
+{
+public:
+    IndexedFilter(const std::shared_ptr<KeyFilterIndex> &index, const std::shared_ptr<KeyFilter> &filter, unsigned int slot)
+        : DefaultKeyFilter(), m_index(index), m_filter(filter), m_slot(slot)
+    {
+        setId(filter->id());
+        setName(filter->name());
+        setIcon(filter->icon());
+        setSpecificity(filter->specificity());
+        setMatchContexts(filter->availableMatchContexts());
+    }
+
+    ~IndexedFilter()
+    {
+        m_index->d->releaseSlot(m_slot);
+    }
+
+    bool matches(const Key &key, MatchContexts ctx) const override
+    {
+        if (ctx != Filtering) {
+            return m_filter->matches(key, ctx);
+        }
+        return m_index->d->matches(m_slot, *m_filter, key);
+    }
+
+private:
+    const std::shared_ptr<KeyFilterIndex> m_index;
+    const std::shared_ptr<KeyFilter> m_filter;
+    const unsigned int m_slot;
+};
+
+KeyFilterIndex::Private::Private(KeyFilterIndex *qq)
+    : q(qq),
+      bitsByFingerprint(),
+      usedSlots(0),
+      indexedFilters()
+{
+    const auto forget = [this](const Key &key) {
+        bitsByFingerprint.remove(QByteArray(key.primaryFingerprint()));
+    };
+    QObject::connect(KeyCache::instance().get(), &KeyCache::added, q, forget);
+    QObject::connect(KeyCache::instance().get(), &KeyCache::aboutToRemove, q, forget);
+}
+
+bool KeyFilterIndex::Private::matches(unsigned int slot, const KeyFilter &filter, const Key &key)
+{
+    const char *const fpr = key.primaryFingerprint();
+    if (!fpr) {
+        return filter.matches(key, KeyFilter::Filtering);
+    }
+    const quint64 bit = quint64(1) << slot;
+    Bits &bits = bitsByFingerprint[QByteArray(fpr)];
+    if (!(bits.evaluated & bit)) {
+        bits.evaluated |= bit;
+        if (filter.matches(key, KeyFilter::Filtering)) {
+            bits.matched |= bit;
+        }
+    }
+    return bits.matched & bit;
+}
+
+void KeyFilterIndex::Private::releaseSlot(unsigned int slot)
+{
+    const quint64 mask = ~(quint64(1) << slot);
+    for (auto it = bitsByFingerprint.begin(), end = bitsByFingerprint.end(); it != end; ++it) {
+        it->evaluated &= mask;
+        it->matched &= mask;
+    }
+    usedSlots &= mask;
+}
+
+KeyFilterIndex::KeyFilterIndex()
+    : QObject(), d(new Private(this))
+{
+}
+
+KeyFilterIndex::~KeyFilterIndex() {}
+
+// static
+std::shared_ptr<KeyFilterIndex> KeyFilterIndex::instance()
+{
+    static std::weak_ptr<KeyFilterIndex> self;
+    try {
+        return std::shared_ptr<KeyFilterIndex>(self);
+    } catch (const std::bad_weak_ptr &) {
+        const std::shared_ptr<KeyFilterIndex> s(new KeyFilterIndex);
+        self = s;
+        return s;
+    }
+}
+
+std::shared_ptr<KeyFilter> KeyFilterIndex::indexedFilter(const std::shared_ptr<KeyFilter> &filter)
+{
+    if (!filter) {
+        return filter;
+    }
+
+    // the same filter (e.g. from KeyFilterManager) shares one slot:
+    const auto it = d->indexedFilters.find(filter.get());
+    if (it != d->indexedFilters.end()) {
+        if (const std::shared_ptr<KeyFilter> indexed = it->second.lock()) {
+            return indexed;
+        }
+        d->indexedFilters.erase(it);
+    }
+
+    unsigned int slot = 0;
+    while (slot < MAX_INDEXED_FILTERS && (d->usedSlots & (quint64(1) << slot))) {
+        ++slot;
+    }
+    if (slot == MAX_INDEXED_FILTERS) {
+        qCDebug(KLEOPATRA_LOG) << "KeyFilterIndex: no free slot for filter" << filter->id();
+        return filter;
+    }
+    d->usedSlots |= quint64(1) << slot;
+
+    const std::shared_ptr<KeyFilter> indexed(new Private::IndexedFilter(instance(), filter, slot));
+    d->indexedFilters[filter.get()] = indexed;
+    return indexed;
+}
@@ -0,0 +1,89 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keyfilterindex.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+#ifndef __KLEOPATRA_UTILS_KEYFILTERINDEX_H__
+#define __KLEOPATRA_UTILS_KEYFILTERINDEX_H__
+
+#include <QObject>
+
+#include <utils/pimpl_ptr.h>
+
+#include <memory>
+
+namespace GpgME
+{
+class Key;
+}
+
+namespace Kleo
+{
+
+class KeyFilter;
+
+/*!
+  \brief Remembers which keys match which key filters
+
+  All key lists showing the same KeyFilter share its results: each
+  distinct filter is evaluated at most once per key, and the result is
+  stored in a per-key bitset, one bit per filter. The bits of a key are
+  dropped when the KeyCache adds (i.e. updates) or removes it.
+
+  indexedFilter() returns a filter that can be set on any proxy model
+  in place of the original one.
+*/
+class KeyFilterIndex : public QObject
+{
+    Q_OBJECT
+public:
+    ~KeyFilterIndex();
+
+    static std::shared_ptr<KeyFilterIndex> instance();
+
+    /*!
+      Returns a filter that behaves like \a filter, but answers
+      KeyFilter::Filtering matches from the index. Returns \a filter
+      itself if it is null or if the index is full.
+    */
+    std::shared_ptr<KeyFilter> indexedFilter(const std::shared_ptr<KeyFilter> &filter);
+
+private:
+    KeyFilterIndex();
+
+private:
+    class Private;
+    kdtools::pimpl_ptr<Private> d;
+};
+
+}
+
+#endif /* __KLEOPATRA_UTILS_KEYFILTERINDEX_H__ */
@@ -0,0 +1,125 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keylisting.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+
+
+#include <config-kleopatra.h>
+
+#include "keylisting.h"
+
+#include <Libkleo/Predicates>
+
+#include <QGpgME/Protocol>
+#include <QGpgME/KeyListJob>
+
+#include <gpgme++/key.h>
+#include <gpgme++/keylistresult.h>
+
+#include "kleopatra_debug.h"
+
+#include <QObject>
+
+#include <algorithm>
+#include <memory>
+
+using namespace Kleo;
+using namespace GpgME;
+
+namespace
+{
+struct Listing {
+    Listing() : pending(0), failed(false) {}
+    unsigned int pending;
+    bool failed;
+    std::vector<Key> publicKeys;
+    std::vector<Key> secretKeys;
+};
+
+// what QGpgME's ListAllKeysJob does for the KeyCache:
+void merge_secret_keys(std::vector<Key> &publicKeys, std::vector<Key> secretKeys)
+{
+    std::sort(secretKeys.begin(), secretKeys.end(), _detail::ByFingerprint<std::less>());
+    for (Key &key : publicKeys) {
+        const auto it = std::lower_bound(secretKeys.cbegin(), secretKeys.cend(), key, _detail::ByFingerprint<std::less>());
+        if (it != secretKeys.cend() && _detail::ByFingerprint<std::equal_to>()(*it, key)) {
+            key.mergeWith(*it);
+        }
+    }
+}
+}
+
+bool Kleo::listKeysWithSecrets(QObject *context, const QStringList &openpgp, const QStringList &cms,
+                               const std::function<void(const std::vector<Key> &, bool)> &done)
+{
+    const auto listing = std::make_shared<Listing>();
+
+    const auto jobDone = [listing, done](const KeyListResult &result) {
+        if (result.error() && !result.error().isCanceled()) {
+            qCDebug(KLEOPATRA_LOG) << "key listing failed:" << result.error().asString();
+            listing->failed = true;
+        }
+        if (--listing->pending) {
+            return;
+        }
+        merge_secret_keys(listing->publicKeys, listing->secretKeys);
+        done(listing->publicKeys, listing->failed);
+    };
+
+    for (const QGpgME::Protocol *const backend : { QGpgME::openpgp(), QGpgME::smime() }) {
+        const QStringList &patterns = backend == QGpgME::openpgp() ? openpgp : cms;
+        if (!backend || patterns.empty()) {
+            continue;
+        }
+        for (const bool secretOnly : { false, true }) {
+            QGpgME::KeyListJob *const job = backend->keyListJob(/*remote*/false, /*includeSigs*/false, /*validate*/!secretOnly);
+            if (!job) {
+                listing->failed = true;
+                continue;
+            }
+            std::vector<Key> &keys = secretOnly ? listing->secretKeys : listing->publicKeys;
+            QObject::connect(job, &QGpgME::KeyListJob::nextKey, context, [&keys, listing](const Key &key) {
+                keys.push_back(key);
+            });
+            QObject::connect(job, &QGpgME::KeyListJob::result, context, jobDone);
+            if (const Error err = job->start(patterns, secretOnly)) {
+                qCDebug(KLEOPATRA_LOG) << "could not start key listing:" << err.asString();
+                delete job;
+                listing->failed = true;
+                continue;
+            }
+            ++listing->pending;
+        }
+    }
+
+    return listing->pending;
+}
@@ -0,0 +1,71 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keylisting.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+
+#ifndef __KLEOPATRA_UTILS_KEYLISTING_H__
+#define __KLEOPATRA_UTILS_KEYLISTING_H__
+
+#include <QStringList>
+
+#include <functional>
+#include <vector>
+
+class QObject;
+
+namespace GpgME
+{
+class Key;
+}
+
+namespace Kleo
+{
+
+/*!
+  Lists the OpenPGP keys matching \a openpgp and the S/MIME keys
+  matching \a cms, like the KeyCache does: the public keys, with
+  validation, are merged with the corresponding secret keys, so that
+  GpgME::Key::hasSecret() of the result is correct.
+
+  \a done is called in the GUI thread once all listings have finished,
+  with the listed keys and whether any listing failed (or could not be
+  started). It is not called if \a context is destroyed first.
+
+  Returns false if no listing could be started at all; \a done is
+  not called then.
+*/
+bool listKeysWithSecrets(QObject *context, const QStringList &openpgp, const QStringList &cms,
+                         const std::function<void(const std::vector<GpgME::Key> &keys, bool failed)> &done);
+
+}
+
+#endif /* __KLEOPATRA_UTILS_KEYLISTING_H__ */
@@ -0,0 +1,304 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keyringwatcher.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+#include <config-kleopatra.h>
+
+#include "keyringwatcher.h"
+
+#include <utils/gnupg-helper.h>
+#include <utils/keylisting.h>
+
+#include <Libkleo/FileSystemWatcher>
+#include <Libkleo/KeyCache>
+
+#include <gpgme++/key.h>
+
+#include "kleopatra_debug.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QTimer>
+
+#include <algorithm>
+
+using namespace Kleo;
+using namespace GpgME;
+
+// A SHA-1 over name, size and mtime of the files the FileSystemWatcher
+// reacts to.
+static QByteArray watched_files_stamp()
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const QFileInfoList files = QDir(gnupgHomeDirectory()).entryInfoList(gnupgFileWhitelist(), QDir::Files, QDir::Name);
+    for (const QFileInfo &fi : files) {
+        hash.addData(QFile::encodeName(fi.fileName()));
+        hash.addData(QByteArray::number(fi.size()));
+        hash.addData(QByteArray::number(fi.lastModified().toMSecsSinceEpoch()));
+    }
+    return hash.result();
+}
+
+// Changes of scope Validity are followed by a full listing after this
+// many milliseconds, so that a series of imports or certifications only
+// leads to one.
+static const int VALIDITY_RELOAD_DELAY = 5000;
+
+class KeyRingWatcher::Private
+{
+    friend class ::Kleo::KeyRingWatcher;
+    KeyRingWatcher *const q;
+public:
+    explicit Private(KeyRingWatcher *qq);
+
+private:
+    void slotTriggered();
+    void beginChange();
+    void endChange(const QStringList &openpgp, const QStringList &cms, ChangeScope scope);
+    void refresh(const QStringList &openpgp, const QStringList &cms, ChangeScope scope);
+    void reloadAll();
+    void changeDone();
+
+private:
+    std::shared_ptr<FileSystemWatcher> watcher;
+    // state of the watched files after the last change we know about
+    QByteArray knownStamp;
+    // state of the watched files when the current changes began
+    QByteArray stampBeforeChange;
+    // the files may have changed externally while changes were in progress
+    bool externalChangePending;
+    unsigned int changesInProgress;
+    unsigned int refreshesInProgress;
+    // coalesces the full listings needed after changes of scope Validity
+    QTimer validityTimer;
+};
+
+KeyRingWatcher::Private::Private(KeyRingWatcher *qq)
+    : q(qq),
+      watcher(new FileSystemWatcher),
+      knownStamp(watched_files_stamp()),
+      externalChangePending(false),
+      changesInProgress(0),
+      refreshesInProgress(0)
+{
+    watcher->whitelistFiles(gnupgFileWhitelist());
+    watcher->addPath(gnupgHomeDirectory());
+    watcher->setDelay(1000);
+    QObject::connect(watcher.get(), &FileSystemWatcher::triggered, q, [this]() { slotTriggered(); });
+
+    validityTimer.setSingleShot(true);
+    validityTimer.setInterval(VALIDITY_RELOAD_DELAY);
+    QObject::connect(&validityTimer, &QTimer::timeout, q, [this]() {
+        qCDebug(KLEOPATRA_LOG) << "KeyRingWatcher: changes may have affected the validity of other keys, reloading all keys";
+        KeyCache::mutableInstance()->startKeyListing();
+    });
+}
+
+void KeyRingWatcher::Private::slotTriggered()
+{
+    if (changesInProgress || refreshesInProgress) {
+        // most likely one of ours, but we can't tell; changeDone() decides
+        externalChangePending = true;
+        return;
+    }
+    const QByteArray stamp = watched_files_stamp();
+    if (stamp == knownStamp) {
+        qCDebug(KLEOPATRA_LOG) << "KeyRingWatcher: ignoring change already handled incrementally";
+        return;
+    }
+    knownStamp = stamp;
+
+    qCDebug(KLEOPATRA_LOG) << "KeyRingWatcher: external modification of the keyrings, reloading all keys";
+    KeyCache::mutableInstance()->startKeyListing();
+}
+
+void KeyRingWatcher::Private::beginChange()
+{
+    if (!changesInProgress && !refreshesInProgress) {
+        stampBeforeChange = watched_files_stamp();
+        // a notification about an external change may still be delayed:
+        externalChangePending = stampBeforeChange != knownStamp;
+    }
+    ++changesInProgress;
+}
+
+void KeyRingWatcher::Private::endChange(const QStringList &openpgp, const QStringList &cms, ChangeScope scope)
+{
+    Q_ASSERT(changesInProgress);
+    --changesInProgress;
+    refresh(openpgp, cms, scope);
+}
+
+void KeyRingWatcher::Private::reloadAll()
+{
+    KeyCache::mutableInstance()->startKeyListing();
+    // the full listing also picks up anything that changed meanwhile
+    externalChangePending = false;
+    validityTimer.stop();
+}
+
+void KeyRingWatcher::Private::changeDone()
+{
+    if (changesInProgress || refreshesInProgress) {
+        return;
+    }
+    const QByteArray stamp = watched_files_stamp();
+    // Files that changed while our own changes were in progress may have been
+    // modified by someone else as well. Our refreshes only cover the keys we
+    // announced, so reload everything rather than lose an external change.
+    if (externalChangePending && stamp != stampBeforeChange) {
+        qCDebug(KLEOPATRA_LOG) << "KeyRingWatcher: keyrings changed during our own changes, reloading all keys";
+        KeyCache::mutableInstance()->startKeyListing();
+    }
+    externalChangePending = false;
+    knownStamp = stamp;
+}
+
+void KeyRingWatcher::Private::refresh(const QStringList &openpgp, const QStringList &cms, ChangeScope scope)
+{
+    QStringList fingerprints = openpgp + cms;
+    fingerprints.removeDuplicates();
+    if (fingerprints.empty()) {
+        changeDone();
+        return;
+    }
+
+    // with the secret keys merged in, like the KeyCache lists them:
+    const bool started = listKeysWithSecrets(q, openpgp, cms, [this, fingerprints, scope](const std::vector<Key> &keys, bool failed) {
+        --refreshesInProgress;
+        if (failed) {
+            qCDebug(KLEOPATRA_LOG) << "KeyRingWatcher: incremental refresh failed, reloading all keys";
+            reloadAll();
+            changeDone();
+            return;
+        }
+
+        const std::shared_ptr<KeyCache> cache = KeyCache::mutableInstance();
+        std::vector<Key> removed;
+        for (const QString &fpr : fingerprints) {
+            const QByteArray fprData = fpr.toLatin1();
+            const bool listed = std::any_of(keys.cbegin(), keys.cend(), [&fprData](const Key &key) {
+                return qstricmp(key.primaryFingerprint(), fprData.constData()) == 0;
+            });
+            if (listed) {
+                continue;
+            }
+            const Key &key = cache->findByFingerprint(fprData.constData());
+            if (!key.isNull()) {
+                removed.push_back(key);
+            }
+        }
+        if (!removed.empty()) {
+            cache->remove(removed);
+        }
+        if (!keys.empty()) {
+            cache->insert(keys);
+        }
+        qCDebug(KLEOPATRA_LOG) << "KeyRingWatcher: refreshed" << keys.size() << "and removed" << removed.size() << "keys";
+
+        // Only OpenPGP keys certify each other (the S/MIME chain validity
+        // is evaluated anew on each listing anyway):
+        if (scope == Validity && std::any_of(keys.cbegin(), keys.cend(), [](const Key &key) {
+                                                 return key.protocol() == OpenPGP;
+                                             })) {
+            validityTimer.start();
+        }
+        changeDone();
+    });
+
+    if (started) {
+        ++refreshesInProgress;
+    } else {
+        qCDebug(KLEOPATRA_LOG) << "KeyRingWatcher: could not start incremental refresh, reloading all keys";
+        reloadAll();
+    }
+    changeDone();
+}
+
+KeyRingWatcher::KeyRingWatcher()
+    : QObject(), d(new Private(this))
+{
+}
+
+KeyRingWatcher::~KeyRingWatcher() {}
+
+// static
+std::shared_ptr<const KeyRingWatcher> KeyRingWatcher::instance()
+{
+    return mutableInstance();
+}
+
+// static
+std::shared_ptr<KeyRingWatcher> KeyRingWatcher::mutableInstance()
+{
+    static std::weak_ptr<KeyRingWatcher> self;
+    try {
+        return std::shared_ptr<KeyRingWatcher>(self);
+    } catch (const std::bad_weak_ptr &) {
+        const std::shared_ptr<KeyRingWatcher> s(new KeyRingWatcher);
+        self = s;
+        return s;
+    }
+}
+
+void KeyRingWatcher::beginChange()
+{
+    d->beginChange();
+}
+
+void KeyRingWatcher::endChange(const std::vector<Key> &keys, ChangeScope scope)
+{
+    QStringList openpgp, cms;
+    for (const Key &key : keys) {
+        if (key.isNull() || !key.primaryFingerprint()) {
+            continue;
+        }
+        (key.protocol() == CMS ? cms : openpgp).push_back(QLatin1String(key.primaryFingerprint()));
+    }
+    openpgp.removeDuplicates();
+    cms.removeDuplicates();
+
+    d->endChange(openpgp, cms, scope);
+}
+
+void KeyRingWatcher::endChange(const QStringList &fingerprints, ChangeScope scope)
+{
+    // we don't know the protocol, so ask both backends:
+    QStringList fprs = fingerprints;
+    fprs.removeDuplicates();
+
+    d->endChange(fprs, fprs, scope);
+}
@@ -0,0 +1,99 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keyringwatcher.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+#ifndef __KLEOPATRA_UTILS_KEYRINGWATCHER_H__
+#define __KLEOPATRA_UTILS_KEYRINGWATCHER_H__
+
+#include <QObject>
+
+#include <utils/pimpl_ptr.h>
+
+#include <memory>
+#include <vector>
+
+class QStringList;
+
+namespace GpgME
+{
+class Key;
+}
+
+namespace Kleo
+{
+
+/*!
+  \brief Keeps the KeyCache in sync with the keyrings on disk
+
+  KeyRingWatcher watches the GnuPG home directory. Changes made by
+  Kleopatra's own commands are announced with beginChange() and
+  endChange(). The affected keys are listed again right away and
+  updated in the KeyCache. Changes that can alter the validity of
+  other OpenPGP keys (e.g. new signatures on a key with owner trust)
+  use scope Validity, which additionally schedules a full listing;
+  the listings of several such changes in a row are coalesced. A full
+  key listing is also started when the keyring files changed in a way
+  no command announced, e.g. by an owner trust change, or if they
+  changed while an announced change was in progress.
+
+  Commands must call endChange() once for every beginChange(), even
+  if the operation failed or was canceled.
+*/
+class KeyRingWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    ~KeyRingWatcher();
+
+    static std::shared_ptr<const KeyRingWatcher> instance();
+    static std::shared_ptr<KeyRingWatcher> mutableInstance();
+
+    enum ChangeScope {
+        AffectedKeys,
+        Validity
+    };
+
+    void beginChange();
+    void endChange(const std::vector<GpgME::Key> &keys, ChangeScope scope = AffectedKeys);
+    void endChange(const QStringList &fingerprints, ChangeScope scope = AffectedKeys);
+
+private:
+    KeyRingWatcher();
+
+private:
+    class Private;
+    kdtools::pimpl_ptr<Private> d;
+};
+
+}
+
+#endif /* __KLEOPATRA_UTILS_KEYRINGWATCHER_H__ */
@@ -0,0 +1,440 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keysearchindex.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+#include <config-kleopatra.h>
+
+#include "keysearchindex.h"
+
+#include <Libkleo/Dn>
+#include <Libkleo/KeyCache>
+
+#include <gpgme++/key.h>
+
+#include "kleopatra_debug.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+
+using namespace Kleo;
+using namespace GpgME;
+
+namespace
+{
+
+// Everything a search can match for \a key, lower-cased.
+QString search_text(const Key &key)
+{
+    QStringList parts;
+    for (const UserID &uid : key.userIDs()) {
+        parts.push_back(QString::fromUtf8(uid.id()));
+        if (key.protocol() == CMS) {
+            // the unescaped DN components:
+            const DN dn(uid.id());
+            for (const DN::Attribute &attr : dn) {
+                parts.push_back(attr.value());
+            }
+        }
+    }
+    parts.push_back(QLatin1String(key.primaryFingerprint()));
+    for (const Subkey &subkey : key.subkeys()) {
+        parts.push_back(QLatin1String(subkey.keyID()));
+    }
+    return parts.join(QLatin1Char('\n')).toLower();
+}
+
+std::vector<quint64> trigrams(const QString &text)
+{
+    std::vector<quint64> result;
+    result.reserve(qMax(0, text.size() - 2));
+    for (int i = 0; i + 2 < text.size(); ++i) {
+        result.push_back((quint64(text[i].unicode()) << 32)
+                         | (quint64(text[i + 1].unicode()) << 16)
+                         | quint64(text[i + 2].unicode()));
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+struct Update {
+    enum Type { Insert, Remove, Rebuild };
+    Type type;
+    std::vector<Key> keys;
+};
+
+struct Query {
+    const QObject *requester;
+    quint64 generation;
+    QString text;
+};
+
+// State shared between the GUI and the index thread.
+struct Shared {
+    Shared() : quit(false) {}
+    QMutex mutex;
+    QWaitCondition condition;
+    bool quit;
+    std::vector<Update> updates;
+    std::deque<Query> queries;
+    std::map<const QObject *, quint64> generations;   // of the latest search per requester
+};
+
+class IndexThread : public QThread
+{
+public:
+    typedef std::function<void(const Query &, const std::shared_ptr<const KeySearchIndex::Matches> &)> ResultHandler;
+
+    IndexThread(Shared *shared, const std::function<void()> &changed, const ResultHandler &result)
+        : QThread(), m_shared(shared), m_changed(changed), m_result(result), m_dead(0) {}
+
+private:
+    void run() override
+    {
+        Q_FOREVER {
+            std::vector<Update> updates;
+            Query query = { nullptr, 0, QString() };
+            {
+                const QMutexLocker locker(&m_shared->mutex);
+                while (!m_shared->quit && m_shared->updates.empty() && m_shared->queries.empty()) {
+                    m_shared->condition.wait(&m_shared->mutex);
+                }
+                if (m_shared->quit) {
+                    return;
+                }
+                updates.swap(m_shared->updates);
+                if (!m_shared->queries.empty()) {
+                    query = m_shared->queries.front();
+                    m_shared->queries.pop_front();
+                }
+            }
+            if (!updates.empty()) {
+                for (const Update &update : updates) {
+                    apply(update);
+                }
+                m_changed();
+            }
+            if (query.requester) {
+                if (const std::shared_ptr<const KeySearchIndex::Matches> matches = search(query)) {
+                    m_result(query, matches);
+                }
+            }
+        }
+    }
+
+    void apply(const Update &update)
+    {
+        if (update.type == Update::Rebuild) {
+            m_entries.clear();
+            m_idByFingerprint.clear();
+            m_postings.clear();
+            m_dead = 0;
+        }
+        for (const Key &key : update.keys) {
+            const char *const fpr = key.primaryFingerprint();
+            if (!fpr) {
+                continue;
+            }
+            remove(QByteArray(fpr));
+            if (update.type != Update::Remove) {
+                insert(QByteArray(fpr), search_text(key));
+            }
+        }
+        if (m_dead > 1024 && m_dead > m_entries.size() / 2) {
+            compact();
+        }
+    }
+
+    void insert(const QByteArray &fpr, const QString &text)
+    {
+        const quint32 id = m_entries.size();
+        m_entries.push_back(Entry{ fpr, text });
+        m_idByFingerprint.insert(fpr, id);
+        // ids only grow, so the posting lists stay sorted:
+        for (const quint64 trigram : trigrams(text)) {
+            m_postings[trigram].push_back(id);
+        }
+    }
+
+    void remove(const QByteArray &fpr)
+    {
+        const auto it = m_idByFingerprint.find(fpr);
+        if (it == m_idByFingerprint.end()) {
+            return;
+        }
+        // the posting lists keep the id; search() skips dead entries
+        Entry &entry = m_entries[it.value()];
+        entry.fingerprint.clear();
+        entry.text.clear();
+        m_idByFingerprint.erase(it);
+        ++m_dead;
+    }
+
+    void compact()
+    {
+        std::vector<Entry> entries;
+        entries.swap(m_entries);
+        m_idByFingerprint.clear();
+        m_postings.clear();
+        m_dead = 0;
+        for (const Entry &entry : entries) {
+            if (!entry.fingerprint.isEmpty()) {
+                insert(entry.fingerprint, entry.text);
+            }
+        }
+    }
+
+    bool isStale(const Query &query) const
+    {
+        const QMutexLocker locker(&m_shared->mutex);
+        const auto it = m_shared->generations.find(query.requester);
+        return m_shared->quit || it == m_shared->generations.end() || it->second != query.generation;
+    }
+
+    std::shared_ptr<KeySearchIndex::Matches> search(const Query &query) const
+    {
+        const QString needle = query.text.toLower();
+        const auto matches = std::make_shared<KeySearchIndex::Matches>();
+        unsigned int checked = 0;
+        const auto check = [&](quint32 id) {
+            const Entry &entry = m_entries[id];
+            if (!entry.fingerprint.isEmpty() && entry.text.contains(needle)) {
+                matches->insert(entry.fingerprint);
+            }
+            return (++checked & 0xfff) || !isStale(query);
+        };
+
+        const std::vector<quint64> needleTrigrams = trigrams(needle);
+        if (needleTrigrams.empty()) {
+            // too short for the index
+            for (quint32 id = 0, end = m_entries.size(); id != end; ++id) {
+                if (!check(id)) {
+                    return std::shared_ptr<KeySearchIndex::Matches>();
+                }
+            }
+            return matches;
+        }
+
+        std::vector<const std::vector<quint32> *> lists;
+        lists.reserve(needleTrigrams.size());
+        for (const quint64 trigram : needleTrigrams) {
+            const auto it = m_postings.find(trigram);
+            if (it == m_postings.end()) {
+                return matches;
+            }
+            lists.push_back(&it.value());
+        }
+        std::sort(lists.begin(), lists.end(), [](const std::vector<quint32> *lhs, const std::vector<quint32> *rhs) {
+            return lhs->size() < rhs->size();
+        });
+        std::vector<quint32> candidates = *lists.front();
+        for (auto it = lists.cbegin() + 1; it != lists.cend() && !candidates.empty(); ++it) {
+            std::vector<quint32> intersection;
+            std::set_intersection(candidates.cbegin(), candidates.cend(), (*it)->cbegin(), (*it)->cend(),
+                                  std::back_inserter(intersection));
+            candidates.swap(intersection);
+        }
+        for (const quint32 id : candidates) {
+            if (!check(id)) {
+                return std::shared_ptr<KeySearchIndex::Matches>();
+            }
+        }
+        return matches;
+    }
+
+private:
+    struct Entry {
+        QByteArray fingerprint;     // empty for removed keys
+        QString text;
+    };
+
+    Shared *const m_shared;
+    const std::function<void()> m_changed;
+    const ResultHandler m_result;
+    std::vector<Entry> m_entries;
+    QHash<QByteArray, quint32> m_idByFingerprint;
+    QHash<quint64, std::vector<quint32>> m_postings;
+    unsigned int m_dead;
+};
+
+}
+
+class KeySearchIndex::Private
+{
+    friend class ::Kleo::KeySearchIndex;
+    KeySearchIndex *const q;
+public:
+    explicit Private(KeySearchIndex *qq);
+    ~Private();
+
+private:
+    void enqueue(Update::Type type, const std::vector<Key> &keys);
+    void deliver(const Query &query, const std::shared_ptr<const Matches> &matches);
+
+private:
+    struct Pending {
+        QPointer<QObject> requester;
+        quint64 generation;
+        Callback callback;
+    };
+    std::map<const QObject *, Pending> pending;
+    quint64 nextGeneration;
+    Shared shared;
+    IndexThread thread;
+};
+
+KeySearchIndex::Private::Private(KeySearchIndex *qq)
+    : q(qq),
+      pending(),
+      nextGeneration(0),
+      shared(),
+      thread(&shared,
+             [this]() { Q_EMIT q->indexChanged(); },
+             [this](const Query &query, const std::shared_ptr<const Matches> &matches) {
+                 QMetaObject::invokeMethod(q, [this, query, matches]() { deliver(query, matches); }, Qt::QueuedConnection);
+             })
+{
+    const std::shared_ptr<const KeyCache> cache = KeyCache::instance();
+    QObject::connect(cache.get(), &KeyCache::keyListingDone, q, [this]() {
+        enqueue(Update::Rebuild, KeyCache::instance()->keys());
+    });
+    QObject::connect(cache.get(), &KeyCache::added, q, [this](const Key &key) {
+        enqueue(Update::Insert, std::vector<Key>(1, key));
+    });
+    QObject::connect(cache.get(), &KeyCache::aboutToRemove, q, [this](const Key &key) {
+        enqueue(Update::Remove, std::vector<Key>(1, key));
+    });
+    if (cache->initialized()) {
+        enqueue(Update::Rebuild, cache->keys());
+    }
+    thread.start(QThread::LowPriority);
+}
+
+KeySearchIndex::Private::~Private()
+{
+    {
+        const QMutexLocker locker(&shared.mutex);
+        shared.quit = true;
+        shared.condition.wakeAll();
+    }
+    thread.wait();
+}
+
+void KeySearchIndex::Private::enqueue(Update::Type type, const std::vector<Key> &keys)
+{
+    const QMutexLocker locker(&shared.mutex);
+    if (type == Update::Rebuild) {
+        // supersedes everything not yet applied
+        shared.updates.clear();
+    } else if (!shared.updates.empty() && shared.updates.back().type == type) {
+        std::vector<Key> &queued = shared.updates.back().keys;
+        queued.insert(queued.end(), keys.begin(), keys.end());
+        return;
+    }
+    shared.updates.push_back(Update{ type, keys });
+    shared.condition.wakeAll();
+}
+
+void KeySearchIndex::Private::deliver(const Query &query, const std::shared_ptr<const Matches> &matches)
+{
+    const auto it = pending.find(query.requester);
+    if (it == pending.end() || it->second.generation != query.generation) {
+        return;
+    }
+    const Pending p = it->second;
+    pending.erase(it);
+    {
+        const QMutexLocker locker(&shared.mutex);
+        shared.generations.erase(query.requester);
+    }
+    if (p.requester) {
+        p.callback(matches);
+    }
+}
+
+KeySearchIndex::KeySearchIndex()
+    : QObject(), d(new Private(this))
+{
+}
+
+KeySearchIndex::~KeySearchIndex() {}
+
+// static
+std::shared_ptr<KeySearchIndex> KeySearchIndex::instance()
+{
+    static std::weak_ptr<KeySearchIndex> self;
+    try {
+        return std::shared_ptr<KeySearchIndex>(self);
+    } catch (const std::bad_weak_ptr &) {
+        const std::shared_ptr<KeySearchIndex> s(new KeySearchIndex);
+        self = s;
+        return s;
+    }
+}
+
+void KeySearchIndex::search(QObject *requester, const QString &text, const Callback &callback)
+{
+    Q_ASSERT(requester);
+    const quint64 generation = ++d->nextGeneration;
+    const Private::Pending p = { requester, generation, callback };
+    d->pending[requester] = p;
+
+    const QMutexLocker locker(&d->shared.mutex);
+    d->shared.generations[requester] = generation;
+    // an older search of the same requester is pointless now:
+    auto &queries = d->shared.queries;
+    queries.erase(std::remove_if(queries.begin(), queries.end(), [requester](const Query &query) {
+                      return query.requester == requester;
+                  }), queries.end());
+    queries.push_back(Query{ requester, generation, text });
+    d->shared.condition.wakeAll();
+}
+
+void KeySearchIndex::cancel(QObject *requester)
+{
+    d->pending.erase(requester);
+    const QMutexLocker locker(&d->shared.mutex);
+    d->shared.generations.erase(requester);
+    auto &queries = d->shared.queries;
+    queries.erase(std::remove_if(queries.begin(), queries.end(), [requester](const Query &query) {
+                      return query.requester == requester;
+                  }), queries.end());
+}
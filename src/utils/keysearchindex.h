@@ -0,0 +1,106 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keysearchindex.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+#ifndef __KLEOPATRA_UTILS_KEYSEARCHINDEX_H__
+#define __KLEOPATRA_UTILS_KEYSEARCHINDEX_H__
+
+#include <QObject>
+#include <QByteArray>
+#include <QSet>
+
+#include <utils/pimpl_ptr.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QString;
+
+namespace GpgME
+{
+class Key;
+}
+
+namespace Kleo
+{
+
+/*!
+  \brief A trigram index over the searchable texts of all keys
+
+  For every key, the user IDs (for CMS also the pretty-printed DN),
+  names, e-mail addresses, fingerprint and (sub)key IDs are indexed,
+  case-insensitively, by the three-character sequences they contain.
+  A search for a text of three or more characters then only needs to
+  look at the keys that contain all of the text's trigrams.
+
+  The index follows the KeyCache on its own. Both updates and searches
+  run in a background thread, so neither blocks the GUI.
+*/
+class KeySearchIndex : public QObject
+{
+    Q_OBJECT
+public:
+    //! the primary fingerprints of the matching keys
+    typedef QSet<QByteArray> Matches;
+    typedef std::function<void(const std::shared_ptr<const Matches> &)> Callback;
+
+    ~KeySearchIndex();
+
+    static std::shared_ptr<KeySearchIndex> instance();
+
+    /*!
+      Searches for keys containing \a text. \a callback is called in the
+      GUI thread, unless \a requester is deleted first or starts
+      another search, which cancels this one.
+    */
+    void search(QObject *requester, const QString &text, const Callback &callback);
+    void cancel(QObject *requester);
+
+Q_SIGNALS:
+    /*!
+      Emitted after keys were added to, updated in or removed from the
+      index. Results of earlier searches may be outdated.
+    */
+    void indexChanged();
+
+private:
+    KeySearchIndex();
+
+private:
+    class Private;
+    kdtools::pimpl_ptr<Private> d;
+};
+
+}
+
+#endif /* __KLEOPATRA_UTILS_KEYSEARCHINDEX_H__ */
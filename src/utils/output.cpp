@@ -256,6 +256,12 @@ public:
     {
         return m_isFinalized;
     }
+    unsigned long long bytesWritten() const override
+    {
+        // sequential devices don't know their size; they have to override this
+        const std::shared_ptr<QIODevice> io = ioDevice();
+        return io && !io->isSequential() ? io->size() : 0;
+    }
     void finalize() override {
         qCDebug(KLEOPATRA_LOG) << this;
         if (m_isFinalized || m_isFinalizing)
@@ -325,6 +331,10 @@ public:
     {
         return m_io;
     }
+    unsigned long long bytesWritten() const override
+    {
+        return m_io->totalBytesWritten();
+    }
     void doFinalize() override {
         m_io->reallyClose();
     }
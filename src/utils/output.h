@@ -86,6 +86,8 @@ public:
     virtual void setBinaryOpt(bool value) = 0;
     /** Whether or not the output failed. */
     virtual bool failed() const { return false; }
+    /** The number of bytes written to the output so far. */
+    virtual unsigned long long bytesWritten() const = 0;
 
     static std::shared_ptr<Output> createFromFile(const QString &fileName, const std::shared_ptr<OverwritePolicy> &);
     static std::shared_ptr<Output> createFromFile(const QString &fileName, bool forceOverwrite);
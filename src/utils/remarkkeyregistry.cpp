@@ -0,0 +1,202 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/remarkkeyregistry.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+
+#include <config-kleopatra.h>
+
+#include "remarkkeyregistry.h"
+
+#include <Libkleo/KeyCache>
+#include <Libkleo/Predicates>
+
+#include <gpgme++/key.h>
+
+#include <KSharedConfig>
+#include <KConfigGroup>
+
+#include <QByteArray>
+#include <QTimer>
+
+#include <algorithm>
+#include <iterator>
+
+using namespace Kleo;
+using namespace GpgME;
+
+static bool is_remark_key(const Key &key)
+{
+    return !key.isNull() && !key.isRevoked() && !key.isExpired()
+           && !key.isDisabled() && !key.isInvalid() && key.protocol() == OpenPGP
+           && key.ownerTrust() >= Key::Full;
+}
+
+class RemarkKeyRegistry::Private
+{
+    friend class ::Kleo::RemarkKeyRegistry;
+    RemarkKeyRegistry *const q;
+public:
+    explicit Private(RemarkKeyRegistry *qq);
+
+private:
+    void rebuild();
+    void update(const Key &key);
+    void remove(const Key &key);
+    void changed();
+
+private:
+    std::vector<Key> keys;
+    quint64 generation;
+    mutable QByteArray remarkKeyFpr;
+    mutable bool remarkKeyFprRead;
+    QTimer notifyTimer;
+};
+
+RemarkKeyRegistry::Private::Private(RemarkKeyRegistry *qq)
+    : q(qq),
+      keys(),
+      generation(0),
+      remarkKeyFpr(),
+      remarkKeyFprRead(false),
+      notifyTimer()
+{
+    notifyTimer.setSingleShot(true);
+    notifyTimer.setInterval(0);
+    QObject::connect(&notifyTimer, &QTimer::timeout, q, [this]() {
+        Q_EMIT q->remarkKeysChanged(generation);
+    });
+
+    const std::shared_ptr<const KeyCache> cache = KeyCache::instance();
+    QObject::connect(cache.get(), &KeyCache::keyListingDone, q, [this]() { rebuild(); });
+    QObject::connect(cache.get(), &KeyCache::added, q, [this](const Key &key) { update(key); });
+    QObject::connect(cache.get(), &KeyCache::aboutToRemove, q, [this](const Key &key) { remove(key); });
+    if (cache->initialized()) {
+        rebuild();
+    }
+}
+
+void RemarkKeyRegistry::Private::rebuild()
+{
+    std::vector<Key> newKeys;
+    const std::vector<Key> all = KeyCache::instance()->keys();
+    std::copy_if(all.begin(), all.end(), std::back_inserter(newKeys), is_remark_key);
+    // the cache's keys are sorted by fingerprint already, but be safe:
+    std::sort(newKeys.begin(), newKeys.end(), _detail::ByFingerprint<std::less>());
+
+    // even with the same fingerprints, the keys' signatures (and thus
+    // the remarks) may have changed, so only an empty set stays quiet:
+    const bool wasEmpty = keys.empty();
+    keys.swap(newKeys);
+    if (!wasEmpty || !keys.empty()) {
+        changed();
+    }
+}
+
+void RemarkKeyRegistry::Private::update(const Key &key)
+{
+    const auto it = std::lower_bound(keys.begin(), keys.end(), key, _detail::ByFingerprint<std::less>());
+    const bool present = it != keys.end() && _detail::ByFingerprint<std::equal_to>()(*it, key);
+    if (is_remark_key(key)) {
+        if (present) {
+            *it = key;
+        } else {
+            keys.insert(it, key);
+        }
+        changed();
+    } else if (present) {
+        keys.erase(it);
+        changed();
+    }
+}
+
+void RemarkKeyRegistry::Private::remove(const Key &key)
+{
+    const auto it = std::lower_bound(keys.begin(), keys.end(), key, _detail::ByFingerprint<std::less>());
+    if (it != keys.end() && _detail::ByFingerprint<std::equal_to>()(*it, key)) {
+        keys.erase(it);
+        changed();
+    }
+}
+
+void RemarkKeyRegistry::Private::changed()
+{
+    ++generation;
+    notifyTimer.start();
+}
+
+RemarkKeyRegistry::RemarkKeyRegistry()
+    : QObject(), d(new Private(this))
+{
+}
+
+RemarkKeyRegistry::~RemarkKeyRegistry() {}
+
+// static
+std::shared_ptr<RemarkKeyRegistry> RemarkKeyRegistry::instance()
+{
+    static std::weak_ptr<RemarkKeyRegistry> self;
+    try {
+        return std::shared_ptr<RemarkKeyRegistry>(self);
+    } catch (const std::bad_weak_ptr &) {
+        const std::shared_ptr<RemarkKeyRegistry> s(new RemarkKeyRegistry);
+        self = s;
+        return s;
+    }
+}
+
+const std::vector<Key> &RemarkKeyRegistry::remarkKeys() const
+{
+    return d->keys;
+}
+
+quint64 RemarkKeyRegistry::generation() const
+{
+    return d->generation;
+}
+
+QByteArray RemarkKeyRegistry::remarkKeyFingerprint() const
+{
+    if (!d->remarkKeyFprRead) {
+        const KConfigGroup conf(KSharedConfig::openConfig(), "RemarkSettings");
+        d->remarkKeyFpr = conf.readEntry("RemarkKeyFpr", QString()).toLatin1();
+        d->remarkKeyFprRead = true;
+    }
+    return d->remarkKeyFpr;
+}
+
+void RemarkKeyRegistry::setRemarkKeyFingerprint(const QByteArray &fpr)
+{
+    KConfigGroup conf(KSharedConfig::openConfig(), "RemarkSettings");
+    conf.writeEntry("RemarkKeyFpr", QString::fromLatin1(fpr));
+    d->remarkKeyFpr = fpr;
+    d->remarkKeyFprRead = true;
+}
@@ -0,0 +1,94 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/remarkkeyregistry.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+
+#ifndef __KLEOPATRA_UTILS_REMARKKEYREGISTRY_H__
+#define __KLEOPATRA_UTILS_REMARKKEYREGISTRY_H__
+
+#include <QObject>
+#include <QByteArray>
+
+#include <utils/pimpl_ptr.h>
+
+#include <memory>
+#include <vector>
+
+namespace GpgME
+{
+class Key;
+}
+
+namespace Kleo
+{
+
+/*!
+  \brief Keeps the keys whose remarks are shown
+
+  The remark keys (see Remarks::remarkKeys()) are computed once from
+  the KeyCache when a key listing is done, and then kept up to date
+  from the keys the KeyCache adds, updates and removes.
+
+  Every change of the set bumps generation() and, once per event loop
+  iteration at most, emits remarkKeysChanged(), so that views only
+  need to re-apply the keys if they have not seen that generation yet.
+*/
+class RemarkKeyRegistry : public QObject
+{
+    Q_OBJECT
+public:
+    ~RemarkKeyRegistry();
+
+    static std::shared_ptr<RemarkKeyRegistry> instance();
+
+    //! the remark keys, sorted by fingerprint
+    const std::vector<GpgME::Key> &remarkKeys() const;
+    quint64 generation() const;
+
+    //! the configured remark key's fingerprint, read from the config only once
+    QByteArray remarkKeyFingerprint() const;
+    void setRemarkKeyFingerprint(const QByteArray &fpr);
+
+Q_SIGNALS:
+    void remarkKeysChanged(quint64 generation);
+
+private:
+    RemarkKeyRegistry();
+
+private:
+    class Private;
+    kdtools::pimpl_ptr<Private> d;
+};
+
+}
+
+#endif /* __KLEOPATRA_UTILS_REMARKKEYREGISTRY_H__ */
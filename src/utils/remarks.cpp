@@ -30,6 +30,7 @@
 */
 
 #include "remarks.h"
+#include "remarkkeyregistry.h"
 #include "kleopatra_debug.h"
 
 #include <KSharedConfig>
@@ -53,13 +54,12 @@ void Remarks::enableRemarks(bool enable)
 
 GpgME::Key Remarks::remarkKey()
 {
-    const KConfigGroup conf(KSharedConfig::openConfig(), "RemarkSettings");
-    const auto remarkKeyFpr = conf.readEntry("RemarkKeyFpr", QString());
+    const auto remarkKeyFpr = RemarkKeyRegistry::instance()->remarkKeyFingerprint();
     GpgME::Key key;
     if (remarkKeyFpr.isEmpty()) {
         return key;
     }
-    key = KeyCache::instance()->findByKeyIDOrFingerprint(remarkKeyFpr.toLatin1().constData());
+    key = KeyCache::instance()->findByKeyIDOrFingerprint(remarkKeyFpr.constData());
     if (key.isNull()) {
         qCDebug(KLEOPATRA_LOG) << "Failed to find remark key: " << remarkKeyFpr;
         return key;
@@ -69,21 +69,10 @@ GpgME::Key Remarks::remarkKey()
 
 std::vector<GpgME::Key> Remarks::remarkKeys()
 {
-    std::vector<GpgME::Key> ret;
-    for (const auto &key: KeyCache::instance()->keys()) {
-        if (key.isNull() || key.isRevoked() || key.isExpired() ||
-            key.isDisabled() || key.isInvalid() || key.protocol() != GpgME::OpenPGP) {
-            continue;
-        }
-        if (key.ownerTrust() >= GpgME::Key::Full) {
-            ret.push_back(key);
-        }
-    }
-    return ret;
+    return RemarkKeyRegistry::instance()->remarkKeys();
 }
 
 void Remarks::setRemarkKey(const GpgME::Key &key)
 {
-    KConfigGroup conf(KSharedConfig::openConfig(), "RemarkSettings");
-    conf.writeEntry("RemarkKeyFpr", key.isNull() ? QString() : QString::fromLatin1(key.primaryFingerprint()));
+    RemarkKeyRegistry::instance()->setRemarkKeyFingerprint(key.isNull() ? QByteArray() : QByteArray(key.primaryFingerprint()));
 }
@@ -47,7 +47,8 @@ GpgME::Key remarkKey();
 void setRemarkKey(const GpgME::Key &key);
 
 /* Get multiple keys to use for remarks. Currently
- * this returns all fully trusted OpenPGP Keys. */
+ * this returns all fully trusted OpenPGP Keys, as
+ * kept by the RemarkKeyRegistry. */
 std::vector<GpgME::Key> remarkKeys();
 }
 } // namespace Kleo
@@ -33,16 +33,127 @@
 #include "keycacheoverlay.h"
 
 #include <Libkleo/KeyCache>
+#include <Libkleo/Formatting>
+
+#include <utils/keycachesnapshot.h>
+
+#include <gpgme++/key.h>
 
 #include "kleopatra_debug.h"
 #include "waitwidget.h"
 
+#include <QAbstractTableModel>
+#include <QAction>
+#include <QApplication>
+#include <QClipboard>
+#include <QDateTime>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QLocale>
+#include <QSortFilterProxyModel>
+#include <QTreeView>
 #include <QVBoxLayout>
 #include <QEvent>
+#include <KConfigGroup>
 #include <KLocalizedString>
+#include <KSharedConfig>
 
 using namespace Kleo;
 
+namespace
+{
+// Read-only view of the certificates from the last session's listing
+// (see KeyCacheSnapshot), shown until the real listing is done.
+class SnapshotModel : public QAbstractTableModel
+{
+public:
+    enum Column { Name, EMail, Validity, Expiry, Fingerprint, NumColumns };
+    enum { FingerprintRole = Qt::UserRole };
+
+    SnapshotModel(const std::shared_ptr<KeyCacheSnapshot> &snapshot, QObject *parent)
+        : QAbstractTableModel(parent), m_snapshot(snapshot) {}
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : m_snapshot->size();
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : NumColumns;
+    }
+
+    QVariant headerData(int section, Qt::Orientation o, int role = Qt::DisplayRole) const override
+    {
+        if (o != Qt::Horizontal || role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        switch (section) {
+        case Name:        return i18n("Name");
+        case EMail:       return i18n("E-Mail");
+        case Validity:    return i18n("User-IDs");
+        case Expiry:      return i18n("Valid Until");
+        case Fingerprint: return i18n("Key-ID");
+        }
+        return QVariant();
+    }
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override
+    {
+        if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::ToolTipRole && role != FingerprintRole)) {
+            return QVariant();
+        }
+        const KeyCacheSnapshot::Entry e = m_snapshot->entry(index.row());
+        if (role == FingerprintRole) {
+            return QString::fromLatin1(e.fingerprint);
+        }
+        switch (index.column()) {
+        case Name:
+            return e.name;
+        case EMail:
+            return e.email;
+        case Validity:
+            return validityString(e);
+        case Expiry:
+            return e.expiration ? QLocale().toString(QDateTime::fromSecsSinceEpoch(e.expiration).date(), QLocale::ShortFormat) : QString();
+        case Fingerprint:
+            return role == Qt::ToolTipRole ? QString::fromLatin1(e.fingerprint) : Formatting::prettyID(e.fingerprint.right(16).constData());
+        }
+        return QVariant();
+    }
+
+private:
+    static QString validityString(const KeyCacheSnapshot::Entry &e)
+    {
+        if (e.capabilities & KeyCacheSnapshot::IsRevoked) {
+            return i18n("revoked");
+        }
+        if (e.capabilities & KeyCacheSnapshot::IsExpired) {
+            return i18n("expired");
+        }
+        if (e.capabilities & KeyCacheSnapshot::IsDisabled) {
+            return i18n("disabled");
+        }
+        switch (e.validity) {
+        case GpgME::UserID::Marginal:
+        case GpgME::UserID::Full:
+        case GpgME::UserID::Ultimate:
+            return i18n("certified");
+        default:
+            return i18n("not certified");
+        }
+    }
+
+private:
+    const std::shared_ptr<KeyCacheSnapshot> m_snapshot;
+};
+
+// How long the last initial listing took, to estimate the progress of this one:
+const char CONFIG_GROUP[] = "KeyCacheOverlay";
+const char CONFIG_DURATION[] = "LastLoadingDuration";
+}
+
 KeyCacheOverlay::KeyCacheOverlay(QWidget *baseWidget, QWidget *parent)
     : QWidget(parent), mBaseWidget(baseWidget)
 {
@@ -56,11 +167,67 @@ KeyCacheOverlay::KeyCacheOverlay(QWidget *baseWidget, QWidget *parent)
 
     auto vLay = new QVBoxLayout(this);
 
-    auto waitWidget = new WaitWidget(this);
+    mWaitWidget = new WaitWidget(this);
+
+    mWaitWidget->setText(i18n("Loading certificate cache..."));
+
+    vLay->addWidget(mWaitWidget);
+
+    mExpectedDuration = KConfigGroup(KSharedConfig::openConfig(), CONFIG_GROUP).readEntry(CONFIG_DURATION, 0);
+
+    // show what we had last time, if the keyrings didn't change since:
+    const std::shared_ptr<KeyCacheSnapshot> snapshot(new KeyCacheSnapshot);
+    if (snapshot->load() && snapshot->size()) {
+        setAutoFillBackground(true);
+
+        auto label = new QLabel(i18n("Until loading is complete, the certificates from the last session are shown. They cannot be used yet."), this);
+        label->setWordWrap(true);
+        vLay->addWidget(label);
 
-    waitWidget->setText(i18n("Loading certificate cache..."));
+        auto filter = new QLineEdit(this);
+        filter->setClearButtonEnabled(true);
+        filter->setPlaceholderText(i18n("Search..."));
+        vLay->addWidget(filter);
 
-    vLay->addWidget(waitWidget);
+        auto proxy = new QSortFilterProxyModel(this);
+        proxy->setSourceModel(new SnapshotModel(snapshot, this));
+        proxy->setFilterKeyColumn(-1);
+        proxy->setFilterCaseSensitivity(Qt::CaseInsensitive);
+        connect(filter, &QLineEdit::textChanged, proxy, &QSortFilterProxyModel::setFilterFixedString);
+
+        auto view = new QTreeView(this);
+        view->setRootIsDecorated(false);
+        view->setUniformRowHeights(true);
+        view->setModel(proxy);
+        // keep the snapshot's order until the user asks for sorting:
+        view->header()->setSortIndicator(-1, Qt::AscendingOrder);
+        view->setSortingEnabled(true);
+        view->setSelectionMode(QAbstractItemView::ExtendedSelection);
+        view->setSelectionBehavior(QAbstractItemView::SelectRows);
+        view->setContextMenuPolicy(Qt::ActionsContextMenu);
+        vLay->addWidget(view, 1);
+
+        auto copyAction = new QAction(QIcon::fromTheme(QStringLiteral("edit-copy")), i18n("Copy Fingerprint"), view);
+        copyAction->setShortcut(QKeySequence::Copy);
+        copyAction->setShortcutContext(Qt::WidgetShortcut);
+        copyAction->setEnabled(false);
+        view->addAction(copyAction);
+        connect(view->selectionModel(), &QItemSelectionModel::selectionChanged, copyAction, [view, copyAction]() {
+            copyAction->setEnabled(view->selectionModel()->hasSelection());
+        });
+        connect(copyAction, &QAction::triggered, view, [view]() {
+            QStringList fingerprints;
+            const auto rows = view->selectionModel()->selectedRows();
+            for (const QModelIndex &idx : rows) {
+                fingerprints.push_back(idx.data(SnapshotModel::FingerprintRole).toString());
+            }
+            QApplication::clipboard()->setText(fingerprints.join(QLatin1Char('\n')));
+        });
+
+        mExpectedCount = snapshot->size();
+
+        qCDebug(KLEOPATRA_LOG) << "Showing" << snapshot->size() << "certificates from the key cache snapshot";
+    }
 
 
     mBaseWidget->installEventFilter(this);
@@ -74,9 +241,13 @@ KeyCacheOverlay::KeyCacheOverlay(QWidget *baseWidget, QWidget *parent)
         if (KeyCache::instance()->initialized()) {
             qCDebug(KLEOPATRA_LOG) << "Hiding overlay from watchdog";
             hideOverlay();
+            return;
         }
+        updateProgress();
     } );
 
+    mElapsed.start();
+    updateProgress();
     mTimer.start(1000);
 
     connect(cache.get(), &KeyCache::keyListingDone, this, &KeyCacheOverlay::hideOverlay);
@@ -108,8 +279,34 @@ void KeyCacheOverlay::reposition()
     resize(mBaseWidget->size());
 }
 
+void KeyCacheOverlay::updateProgress()
+{
+    const qint64 elapsed = mElapsed.elapsed();
+    // Estimate from the last listing; fall back to a busy indicator when
+    // there is none or this listing already takes longer:
+    if (mExpectedDuration > 0 && elapsed < mExpectedDuration) {
+        mWaitWidget->setProgress(static_cast<int>(elapsed), mExpectedDuration);
+    } else {
+        mWaitWidget->setProgress(0, 0);
+    }
+
+    const int seconds = elapsed / 1000;
+    if (mExpectedCount) {
+        mWaitWidget->setDetails(i18np("Listing about %2 certificates for 1 second",
+                                      "Listing about %2 certificates for %1 seconds",
+                                      seconds, mExpectedCount));
+    } else {
+        mWaitWidget->setDetails(i18np("Listing certificates for 1 second",
+                                      "Listing certificates for %1 seconds", seconds));
+    }
+}
+
 void KeyCacheOverlay::hideOverlay()
 {
+   if (mElapsed.isValid()) {
+       KConfigGroup(KSharedConfig::openConfig(), CONFIG_GROUP).writeEntry(CONFIG_DURATION, int(mElapsed.elapsed()));
+       mElapsed.invalidate();
+   }
    mTimer.stop();
    mBaseWidget->setEnabled(true);
    hide();
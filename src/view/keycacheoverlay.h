@@ -34,10 +34,13 @@
 
 #include <QWidget>
 #include <QTimer>
+#include <QElapsedTimer>
 
 namespace Kleo
 {
 
+class WaitWidget;
+
 /**
  * @internal
  * Overlay widget to block KeyCache-dependent widgets if the Keycache
@@ -59,6 +62,7 @@ protected:
 
 private:
     void reposition();
+    void updateProgress();
 
 private Q_SLOTS:
     /** Hides the overlay and triggers deletion. */
@@ -67,6 +71,10 @@ private Q_SLOTS:
 private:
     QWidget *mBaseWidget;
     QTimer mTimer;
+    QElapsedTimer mElapsed;
+    WaitWidget *mWaitWidget = nullptr;
+    int mExpectedDuration = 0;
+    int mExpectedCount = 0;
 };
 
 } // namespace Kleo
@@ -38,6 +38,8 @@
 #include <smartcard/readerstatus.h>
 
 #include <utils/action_data.h>
+#include <utils/itemselection.h>
+#include <utils/keydisplaycache.h>
 
 #include "tooltippreferences.h"
 #include "kleopatra_debug.h"
@@ -72,6 +74,7 @@
 #include <Libkleo/KeyCache>
 #include <Libkleo/KeyListModel>
 #include <Libkleo/Formatting>
+#include <Libkleo/Predicates>
 
 
 #include <gpgme++/key.h>
@@ -83,8 +86,11 @@
 #include <QPointer>
 #include <QItemSelectionModel>
 #include <QAction>
+#include <QTimer>
+#include <QTreeView>
 
 #include <algorithm>
+#include <map>
 
 using namespace Kleo;
 using namespace Kleo::Commands;
@@ -131,11 +137,26 @@ public:
     }
     void slotDoubleClicked(const QModelIndex &idx);
     void slotActivated(const QModelIndex &idx);
-    void slotSelectionChanged(const QItemSelection &old, const QItemSelection &new_);
+    void slotSelectionChanged(const QItemSelection &selected, const QItemSelection &deselected);
     void slotContextMenu(const QPoint &pos);
     void slotCommandFinished();
     void slotAddKey(const Key &key);
     void slotAboutToRemoveKey(const Key &key);
+
+    void flushKeyCacheChanges();
+
+    // What a view shows of the models, by key, so it survives a reset
+    // of the models:
+    struct ViewState {
+        QPointer<QAbstractItemView> view;
+        std::vector<Key> selected;
+        std::vector<Key> expanded;
+        Key current;
+        Key topmost;
+    };
+    std::vector<ViewState> saveViewStates() const;
+    void restoreViewStates(const std::vector<ViewState> &states);
+
     void slotProgress(const QString &what, int current, int total)
     {
         Q_EMIT q->progress(current, total);
@@ -158,7 +179,29 @@ private:
     int toolTipOptions() const;
 
 private:
-    static Command::Restrictions calculateRestrictionsMask(const QItemSelectionModel *sm);
+    Command::Restrictions calculateRestrictionsMask(const QItemSelectionModel *sm) const;
+
+    // What calculateRestrictionsMask() needs to know about the keys
+    // selected in one view. Kept up to date from the selection deltas,
+    // and recounted only after the model changed.
+    struct SelectionStats {
+        SelectionStats() : valid(false)
+        {
+            reset();
+        }
+        void reset()
+        {
+            keys = secret = openpgp = cms = secretUltimate = nonRoot = trustedRoot = 0;
+        }
+        void add(const Key &key, int n);
+        void add(const QItemSelection &selection, const KeyListModelInterface *m, int n);
+
+        QPointer<QAbstractItemModel> model;
+        std::vector<QMetaObject::Connection> modelConnections;
+        bool valid;
+        int keys, secret, openpgp, cms, secretUltimate, nonRoot, trustedRoot;
+    };
+    SelectionStats &selectionStats(const QItemSelectionModel *sm) const;
 
 private:
     struct action_item {
@@ -167,12 +210,21 @@ private:
         Command *(*createCommand)(QAbstractItemView *, KeyListController *);
     };
     std::vector<action_item> actions;
+    mutable std::map<const QItemSelectionModel *, SelectionStats> selectionStatsBySelectionModel;
     std::vector<QAbstractItemView *> views;
     std::vector<Command *> commands;
     QPointer<QWidget> parentWidget;
     QPointer<TabWidget> tabWidget;
     QPointer<QAbstractItemView> currentView;
     QPointer<AbstractKeyListModel> flatModel, hierarchicalModel;
+
+    // KeyCache changes of one event loop turn, applied in one go
+    // (true = added, false = removed):
+    std::vector<std::pair<Key, bool>> pendingKeyCacheChanges;
+    QTimer keyCacheChangesTimer;
+
+    // the texts of the keys in the views, formatted with our tool tip options:
+    std::shared_ptr<KeyDisplayCache> displayCache;
 };
 
 KeyListController::Private::Private(KeyListController *qq)
@@ -183,12 +235,18 @@ KeyListController::Private::Private(KeyListController *qq)
       parentWidget(),
       tabWidget(),
       flatModel(),
-      hierarchicalModel()
+      hierarchicalModel(),
+      displayCache(KeyDisplayCache::instance())
 {
     connect(KeyCache::mutableInstance().get(), SIGNAL(added(GpgME::Key)),
             q, SLOT(slotAddKey(GpgME::Key)));
     connect(KeyCache::mutableInstance().get(), SIGNAL(aboutToRemove(GpgME::Key)),
             q, SLOT(slotAboutToRemoveKey(GpgME::Key)));
+
+    keyCacheChangesTimer.setSingleShot(true);
+    keyCacheChangesTimer.setInterval(0);
+    QObject::connect(&keyCacheChangesTimer, &QTimer::timeout,
+                     q, [this]() { flushKeyCacheChanges(); });
 }
 
 KeyListController::Private::~Private() {}
@@ -203,23 +261,140 @@ KeyListController::~KeyListController() {}
 
 void KeyListController::Private::slotAddKey(const Key &key)
 {
-    // ### make model act on keycache directly...
-    if (flatModel) {
-        flatModel->addKey(key);
-    }
-    if (hierarchicalModel) {
-        hierarchicalModel->addKey(key);
+    pendingKeyCacheChanges.emplace_back(key, true);
+    if (!keyCacheChangesTimer.isActive()) {
+        keyCacheChangesTimer.start();
     }
 }
 
 void KeyListController::Private::slotAboutToRemoveKey(const Key &key)
+{
+    pendingKeyCacheChanges.emplace_back(key, false);
+    if (!keyCacheChangesTimer.isActive()) {
+        keyCacheChangesTimer.start();
+    }
+}
+
+// Beyond this many removals, resetting the models is cheaper than
+// removing the rows one by one.
+static const unsigned int MAX_SINGLE_ROW_REMOVALS = 100;
+
+void KeyListController::Private::flushKeyCacheChanges()
 {
     // ### make model act on keycache directly...
-    if (flatModel) {
-        flatModel->removeKey(key);
+    std::vector<std::pair<Key, bool>> changes;
+    changes.swap(pendingKeyCacheChanges);
+    if (changes.empty()) {
+        return;
+    }
+
+    // Only the last change of each key counts. Reverse, so that it is
+    // the first of its group after the (stable) sort:
+    const auto byFingerprint = [](const std::pair<Key, bool> &lhs, const std::pair<Key, bool> &rhs) {
+        return _detail::ByFingerprint<std::less>()(lhs.first, rhs.first);
+    };
+    const auto sameFingerprint = [](const std::pair<Key, bool> &lhs, const std::pair<Key, bool> &rhs) {
+        return _detail::ByFingerprint<std::equal_to>()(lhs.first, rhs.first);
+    };
+    std::reverse(changes.begin(), changes.end());
+    std::stable_sort(changes.begin(), changes.end(), byFingerprint);
+    changes.erase(std::unique(changes.begin(), changes.end(), sameFingerprint), changes.end());
+
+    std::vector<Key> added, removed;
+    for (const auto &change : changes) {
+        (change.second ? added : removed).push_back(change.first);
+    }
+
+    const auto cache = KeyCache::instance();
+    if (removed.size() > MAX_SINGLE_ROW_REMOVALS && cache->initialized()) {
+        // the KeyCache already reflects all of the changes:
+        const std::vector<ViewState> states = saveViewStates();
+        for (AbstractKeyListModel *model : { flatModel.data(), hierarchicalModel.data() }) {
+            if (model) {
+                model->clear();
+                model->addKeys(cache->keys());
+            }
+        }
+        restoreViewStates(states);
+        return;
+    }
+
+    for (AbstractKeyListModel *model : { flatModel.data(), hierarchicalModel.data() }) {
+        if (!model) {
+            continue;
+        }
+        for (const Key &key : removed) {
+            model->removeKey(key);
+        }
+        if (!added.empty()) {
+            // sorted by fingerprint, so the model can merge them in one pass:
+            model->addKeys(added);
+        }
+    }
+}
+
+static void collect_expanded_keys(const QTreeView *view, const KeyListModelInterface *m,
+                                  const QModelIndex &parent, std::vector<Key> &keys)
+{
+    const QAbstractItemModel *const model = view->model();
+    for (int row = 0, rows = model->rowCount(parent); row < rows; ++row) {
+        const QModelIndex idx = model->index(row, 0, parent);
+        if (view->isExpanded(idx)) {
+            keys.push_back(m->key(idx));
+            collect_expanded_keys(view, m, idx, keys);
+        }
     }
-    if (hierarchicalModel) {
-        hierarchicalModel->removeKey(key);
+}
+
+std::vector<KeyListController::Private::ViewState> KeyListController::Private::saveViewStates() const
+{
+    std::vector<ViewState> states;
+    for (QAbstractItemView *view : views) {
+        const KeyListModelInterface *const m = dynamic_cast<const KeyListModelInterface *>(view->model());
+        if (!m) {
+            continue;
+        }
+        ViewState state;
+        state.view = view;
+        if (view->selectionModel()) {
+            state.selected = m->keys(view->selectionModel()->selectedRows());
+        }
+        if (const QTreeView *const tv = qobject_cast<const QTreeView *>(view)) {
+            collect_expanded_keys(tv, m, QModelIndex(), state.expanded);
+        }
+        state.current = m->key(view->currentIndex());
+        state.topmost = m->key(view->indexAt(QPoint(0, 0)));
+        states.push_back(state);
+    }
+    return states;
+}
+
+void KeyListController::Private::restoreViewStates(const std::vector<ViewState> &states)
+{
+    for (const ViewState &state : states) {
+        QAbstractItemView *const view = state.view;
+        const KeyListModelInterface *const m = view ? dynamic_cast<const KeyListModelInterface *>(view->model()) : nullptr;
+        if (!m) {
+            continue;
+        }
+        if (QTreeView *const tv = qobject_cast<QTreeView *>(view)) {
+            for (const QModelIndex &idx : m->indexes(state.expanded)) {
+                tv->expand(idx);
+            }
+        }
+        if (!state.current.isNull()) {
+            view->selectionModel()->setCurrentIndex(m->index(state.current), QItemSelectionModel::NoUpdate);
+        }
+        if (!state.selected.empty()) {
+            view->selectionModel()->select(rowSelectionFromIndexes(m->indexes(state.selected)),
+                                           QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+        }
+        if (!state.topmost.isNull()) {
+            const QModelIndex idx = m->index(state.topmost);
+            if (idx.isValid()) {
+                view->scrollTo(idx, QAbstractItemView::PositionAtTop);
+            }
+        }
     }
 }
 
@@ -263,6 +438,7 @@ void KeyListController::setFlatModel(AbstractKeyListModel *model)
             model->addKeys(KeyCache::instance()->keys());
         }
         model->setToolTipOptions(d->toolTipOptions());
+        d->displayCache->setToolTipOptions(d->toolTipOptions());
     }
 }
 
@@ -280,6 +456,7 @@ void KeyListController::setHierarchicalModel(AbstractKeyListModel *model)
             model->addKeys(KeyCache::instance()->keys());
         }
         model->setToolTipOptions(d->toolTipOptions());
+        d->displayCache->setToolTipOptions(d->toolTipOptions());
     }
 }
 
@@ -643,15 +820,18 @@ void KeyListController::Private::slotActivated(const QModelIndex &idx)
 
 }
 
-void KeyListController::Private::slotSelectionChanged(const QItemSelection &old, const QItemSelection &new_)
+void KeyListController::Private::slotSelectionChanged(const QItemSelection &selected, const QItemSelection &deselected)
 {
-    Q_UNUSED(old);
-    Q_UNUSED(new_);
-
     const QItemSelectionModel *const sm = qobject_cast<QItemSelectionModel *>(q->sender());
     if (!sm) {
         return;
     }
+    SelectionStats &stats = selectionStats(sm);
+    if (stats.valid) {
+        const KeyListModelInterface *const m = dynamic_cast<const KeyListModelInterface *>(sm->model());
+        stats.add(deselected, m, -1);
+        stats.add(selected, m, +1);
+    }
     q->enableDisableActions(sm);
 }
 
@@ -686,42 +866,80 @@ void KeyListController::enableDisableActions(const QItemSelectionModel *sm) cons
         }
 }
 
-static bool all_secret_are_not_owner_trust_ultimate(const std::vector<Key> &keys)
+void KeyListController::Private::SelectionStats::add(const Key &key, int n)
+{
+    keys += n;
+    if (key.hasSecret()) {
+        secret += n;
+        if (key.ownerTrust() == Key::Ultimate) {
+            secretUltimate += n;
+        }
+    }
+    if (key.protocol() == OpenPGP) {
+        openpgp += n;
+    } else if (key.protocol() == CMS) {
+        cms += n;
+    }
+    if (!key.isRoot()) {
+        nonRoot += n;
+    } else if (key.userID(0).validity() == UserID::Ultimate) {
+        trustedRoot += n;
+    }
+}
+
+void KeyListController::Private::SelectionStats::add(const QItemSelection &selection, const KeyListModelInterface *m, int n)
 {
-    for (const Key &key : keys)
-        if (key.hasSecret() && key.ownerTrust() == Key::Ultimate) {
-            return false;
+    if (!m) {
+        return;
+    }
+    for (const QItemSelectionRange &range : selection) {
+        // count each row once, by its first column (cf. selectedRows()):
+        if (!range.isValid() || range.left() != 0) {
+            continue;
+        }
+        for (int row = range.top(), end = range.bottom(); row <= end; ++row) {
+            add(m->key(range.model()->index(row, 0, range.parent())), n);
         }
-    return true;
+    }
 }
 
-Command::Restrictions find_root_restrictions(const std::vector<Key> &keys)
+KeyListController::Private::SelectionStats &KeyListController::Private::selectionStats(const QItemSelectionModel *sm) const
 {
-    bool trusted = false, untrusted = false;
-    for (const Key &key : keys)
-        if (key.isRoot())
-            if (key.userID(0).validity() == UserID::Ultimate) {
-                trusted = true;
-            } else {
-                untrusted = true;
-            }
-        else {
-            return Command::NoRestriction;
+    SelectionStats &stats = selectionStatsBySelectionModel[sm];
+    if (stats.model != sm->model()) {
+        for (const QMetaObject::Connection &connection : stats.modelConnections) {
+            QObject::disconnect(connection);
         }
-    if (trusted)
-        if (untrusted) {
-            return Command::NoRestriction;
-        } else {
-            return Command::MustBeTrustedRoot;
+        stats.modelConnections.clear();
+        if (!stats.model) {
+            QObject::connect(sm, &QObject::destroyed, q, [this, sm]() {
+                selectionStatsBySelectionModel.erase(sm);
+            });
+        }
+        stats.model = const_cast<QAbstractItemModel *>(sm->model());
+        stats.valid = false;
+        if (stats.model) {
+            // the selection model doesn't report (all) rows leaving the
+            // selection that way, and keys may change in place:
+            const auto invalidate = [this, sm]() {
+                const auto it = selectionStatsBySelectionModel.find(sm);
+                if (it != selectionStatsBySelectionModel.end()) {
+                    it->second.valid = false;
+                }
+            };
+            stats.modelConnections = {
+                QObject::connect(stats.model, &QAbstractItemModel::dataChanged, q, invalidate),
+                QObject::connect(stats.model, &QAbstractItemModel::rowsAboutToBeRemoved, q, invalidate),
+                QObject::connect(stats.model, &QAbstractItemModel::rowsMoved, q, invalidate),
+                QObject::connect(stats.model, &QAbstractItemModel::layoutChanged, q, invalidate),
+                QObject::connect(stats.model, &QAbstractItemModel::modelReset, q, invalidate),
+            };
         }
-    else if (untrusted) {
-        return Command::MustBeUntrustedRoot;
-    } else {
-        return Command::NoRestriction;
     }
+    return stats;
 }
 
-Command::Restrictions KeyListController::Private::calculateRestrictionsMask(const QItemSelectionModel *sm)
+Command::Restrictions KeyListController::Private::calculateRestrictionsMask(const QItemSelectionModel *sm) const
 {
     if (!sm) {
         return Command::NoRestriction;
@@ -732,34 +950,49 @@ Command::Restrictions KeyListController::Private::calculateRestrictionsMask(cons
         return Command::NoRestriction;
     }
 
-    const std::vector<Key> keys = m->keys(sm->selectedRows());
-    if (keys.empty()) {
+    SelectionStats &stats = selectionStats(sm);
+    if (!stats.valid) {
+        stats.reset();
+        Q_FOREACH (const QModelIndex &idx, sm->selectedRows()) {
+            stats.add(m->key(idx), +1);
+        }
+        stats.valid = true;
+    }
+
+    if (!stats.keys) {
         return Command::NoRestriction;
     }
 
     Command::Restrictions result = Command::NeedSelection;
 
-    if (keys.size() == 1) {
+    if (stats.keys == 1) {
         result |= Command::OnlyOneKey;
     }
 
-    if (std::all_of(keys.cbegin(), keys.cend(), std::mem_fn(&Key::hasSecret))) {
+    if (stats.secret == stats.keys) {
         result |= Command::NeedSecretKey;
-    } else if (!std::any_of(keys.cbegin(), keys.cend(), std::mem_fn(&Key::hasSecret))) {
+    } else if (!stats.secret) {
         result |= Command::MustNotBeSecretKey;
     }
 
-    if (std::all_of(keys.cbegin(), keys.cend(), [](const Key &key) { return key.protocol() == OpenPGP; })) {
+    if (stats.openpgp == stats.keys) {
         result |= Command::MustBeOpenPGP;
-    } else if (std::all_of(keys.cbegin(), keys.cend(), [](const Key &key) { return key.protocol() == CMS; })) {
+    } else if (stats.cms == stats.keys) {
         result |= Command::MustBeCMS;
     }
 
-    if (all_secret_are_not_owner_trust_ultimate(keys)) {
+    if (!stats.secretUltimate) {
         result |= Command::MayOnlyBeSecretKeyIfOwnerTrustIsNotYetUltimate;
     }
 
-    result |= find_root_restrictions(keys);
+    if (!stats.nonRoot) {
+        const int untrustedRoot = stats.keys - stats.trustedRoot;
+        if (stats.trustedRoot && !untrustedRoot) {
+            result |= Command::MustBeTrustedRoot;
+        } else if (untrustedRoot && !stats.trustedRoot) {
+            result |= Command::MustBeUntrustedRoot;
+        }
+    }
 
     if (const ReaderStatus *rs = ReaderStatus::instance()) {
         if (rs->anyCardHasNullPin()) {
@@ -820,6 +1053,9 @@ void KeyListController::updateConfig()
     if (d->hierarchicalModel) {
         d->hierarchicalModel->setToolTipOptions(opts);
     }
+    d->displayCache->setToolTipOptions(opts);
+    // other settings, e.g. the date format, may have changed, too:
+    d->displayCache->invalidate();
 }
 
 #include "moc_keylistcontroller.cpp"
@@ -40,10 +40,15 @@
 #include <Libkleo/Predicates>
 
 #include "utils/headerview.h"
+#include "utils/itemselection.h"
+#include "utils/keydisplaycache.h"
+#include "utils/keyfilterindex.h"
+#include "utils/keysearchindex.h"
 #include "utils/remarks.h"
 
 #include <Libkleo/Stl_Util>
 #include <Libkleo/KeyFilter>
+#include <Libkleo/DefaultKeyFilter>
 #include <Libkleo/KeyCache>
 
 #include <gpgme++/key.h>
@@ -60,11 +65,14 @@
 #include <QAction>
 #include <QEvent>
 #include <QContextMenuEvent>
+#include <QPersistentModelIndex>
 
 #include <KSharedConfig>
 #include <KConfigGroup>
 #include <KLocalizedString>
 
+#include <algorithm>
+
 #include <gpgme++/gpgmepp_version.h>
 #if GPGMEPP_VERSION >= 0x10E00 // 1.14.0
 # define GPGME_HAS_REMARKS
@@ -80,6 +88,33 @@ Q_DECLARE_METATYPE(GpgME::Key)
 namespace
 {
 
+// Lets through the keys found by the last search, if they also match
+// the view's key filter.
+class SearchResultFilter : public DefaultKeyFilter
+{
+public:
+    SearchResultFilter(const std::shared_ptr<const KeySearchIndex::Matches> &matches, const std::shared_ptr<KeyFilter> &filter)
+        : DefaultKeyFilter(), m_matches(matches), m_filter(filter)
+    {
+        if (filter) {
+            setId(filter->id());
+            setName(filter->name());
+            setIcon(filter->icon());
+        }
+        setMatchContexts(Filtering);
+    }
+
+    bool matches(const Key &key, MatchContexts ctx) const override
+    {
+        return m_matches && m_matches->contains(QByteArray(key.primaryFingerprint()))
+               && (!m_filter || m_filter->matches(key, ctx));
+    }
+
+private:
+    const std::shared_ptr<const KeySearchIndex::Matches> m_matches;
+    const std::shared_ptr<KeyFilter> m_filter;
+};
+
 class TreeView : public QTreeView
 {
 public:
@@ -150,33 +185,193 @@ private:
 
 } // anon namespace
 
+// Sizes the columns to their contents without measuring every row:
+// only a bounded sample of the rows is looked at, and of those only
+// the longest texts per column are kept as candidates for the widest
+// cell. The rows the model inserts later are sampled as they come in.
+// The widths are cached per column and font, and are only measured
+// again when the candidates change.
+class KeyTreeView::ColumnSizer
+{
+public:
+    ColumnSizer() : m_columns(), m_fontKey(), m_sampled(false), m_sampledRows(0), m_sampleCredit(0) {}
+
+    void reset()
+    {
+        m_columns.clear();
+        m_sampled = false;
+        m_sampledRows = 0;
+        m_sampleCredit = 0;
+    }
+
+    void rowsInserted(const QAbstractItemModel *model, int first, int last)
+    {
+        // before the first sizing, all rows are sampled anyway
+        if (!m_sampled) {
+            return;
+        }
+        // The sort proxy reports insertions in many small ranges. Sample
+        // each range in proportion to its share of all rows, so that a
+        // model filled range by range isn't sampled row by row:
+        const int count = last - first + 1;
+        m_sampleCredit += double(count) * MAX_SAMPLED_ROWS / std::max(1, model->rowCount());
+        const int samples = std::min(count, static_cast<int>(m_sampleCredit));
+        if (samples > 0) {
+            m_sampleCredit -= samples;
+            sampleRows(model, first, last, samples);
+        }
+    }
+
+    void resizeColumns(QTreeView *view, int firstColumn)
+    {
+        const QAbstractItemModel *const model = view->model();
+        // an empty model is sampled once it has rows (see rowsInserted())
+        if (!m_sampled && model->rowCount() > 0) {
+            sampleRows(model, 0, model->rowCount() - 1, MAX_SAMPLED_ROWS);
+            m_sampled = true;
+        }
+        const QString fontKey = view->font().key();
+        if (fontKey != m_fontKey) {
+            m_fontKey = fontKey;
+            for (Column &column : m_columns) {
+                column.width = -1;
+            }
+        }
+        for (int col = firstColumn; col < model->columnCount(); ++col) {
+            if (view->isColumnHidden(col)) {
+                continue;
+            }
+            view->setColumnWidth(col, std::max(contentWidth(view, col), view->header()->sectionSizeHint(col)));
+        }
+    }
+
+private:
+    // the number of rows looked at, at most, per sampling
+    static const int MAX_SAMPLED_ROWS = 500;
+    // the number of rows looked at, at most, between two resets
+    static const int MAX_TOTAL_SAMPLED_ROWS = 4 * MAX_SAMPLED_ROWS;
+    // the number of longest texts kept per column
+    static const int MAX_CANDIDATES = 3;
+
+    struct Candidate {
+        QPersistentModelIndex index;
+        int length;
+    };
+    struct Column {
+        Column() : candidates(), width(-1) {}
+        std::vector<Candidate> candidates; // longest first
+        int width; // -1 if the candidates changed since the last measuring
+    };
+
+    void sampleRows(const QAbstractItemModel *model, int first, int last, int samples)
+    {
+        samples = std::min(samples, MAX_TOTAL_SAMPLED_ROWS - m_sampledRows);
+        if (samples <= 0) {
+            return;
+        }
+        const int step = std::max(1, (last - first + 1) / samples);
+        for (int row = first; row <= last && samples > 0; row += step, --samples) {
+            sampleRow(model, row);
+        }
+    }
+
+    void sampleRow(const QAbstractItemModel *model, int row)
+    {
+        const int columnCount = model->columnCount();
+        if (static_cast<int>(m_columns.size()) < columnCount) {
+            m_columns.resize(columnCount);
+        }
+        for (int col = 0; col < columnCount; ++col) {
+            const QModelIndex idx = model->index(row, col);
+            const int length = idx.data(Qt::DisplayRole).toString().size();
+            Column &column = m_columns[col];
+            if (static_cast<int>(column.candidates.size()) == MAX_CANDIDATES
+                && length <= column.candidates.back().length) {
+                continue;
+            }
+            const auto it = std::find_if(column.candidates.begin(), column.candidates.end(),
+                                         [length](const Candidate &c) { return c.length < length; });
+            column.candidates.insert(it, Candidate{ QPersistentModelIndex(idx), length });
+            if (static_cast<int>(column.candidates.size()) > MAX_CANDIDATES) {
+                column.candidates.pop_back();
+            }
+            column.width = -1;
+        }
+        ++m_sampledRows;
+    }
+
+    int contentWidth(QTreeView *view, int col)
+    {
+        if (col >= static_cast<int>(m_columns.size())) {
+            return 0;
+        }
+        Column &column = m_columns[col];
+        // candidates whose rows are gone can no longer be the widest:
+        const auto gone = std::remove_if(column.candidates.begin(), column.candidates.end(),
+                                         [](const Candidate &c) { return !c.index.isValid(); });
+        if (gone != column.candidates.end()) {
+            column.candidates.erase(gone, column.candidates.end());
+            column.width = -1;
+        }
+        if (column.width < 0) {
+            column.width = 0;
+            for (const Candidate &c : column.candidates) {
+                column.width = std::max(column.width, view->sizeHintForIndex(c.index).width());
+            }
+        }
+        return column.width;
+    }
+
+private:
+    std::vector<Column> m_columns;
+    QString m_fontKey;
+    bool m_sampled;
+    int m_sampledRows;
+    double m_sampleCredit;
+};
+
 KeyTreeView::KeyTreeView(QWidget *parent)
     : QWidget(parent),
+      m_keys(std::make_shared<std::vector<Key>>()),
       m_proxy(new KeyListSortFilterProxyModel(this)),
       m_additionalProxy(nullptr),
+      m_displayCacheProxy(nullptr),
       m_view(new TreeView(this)),
       m_flatModel(nullptr),
       m_hierarchicalModel(nullptr),
       m_stringFilter(),
       m_keyFilter(),
-      m_isHierarchical(true)
+      m_isHierarchical(true),
+      m_onceResized(false),
+      m_searchRunning(false),
+      m_searchOutdated(false)
 {
     init();
 }
 
 KeyTreeView::KeyTreeView(const KeyTreeView &other)
     : QWidget(nullptr),
+      m_keys(other.m_keys),
       m_proxy(new KeyListSortFilterProxyModel(this)),
       m_additionalProxy(other.m_additionalProxy ? other.m_additionalProxy->clone() : nullptr),
+      m_displayCacheProxy(nullptr),
       m_view(new TreeView(this)),
       m_flatModel(other.m_flatModel),
       m_hierarchicalModel(other.m_hierarchicalModel),
       m_stringFilter(other.m_stringFilter),
       m_keyFilter(other.m_keyFilter),
+      m_searchIndex(other.m_searchIndex),
+      m_searchMatches(other.m_searchMatches),
       m_group(other.m_group),
-      m_isHierarchical(other.m_isHierarchical)
+      m_isHierarchical(other.m_isHierarchical),
+      m_onceResized(false),
+      m_searchRunning(false),
+      m_searchOutdated(false)
 {
     init();
+    if (other.m_displayCacheProxy) {
+        setUseDisplayCache(true);
+    }
     setColumnSizes(other.columnSizes());
     setSortColumn(other.sortColumn(), other.sortOrder());
 }
@@ -185,8 +380,10 @@ KeyTreeView::KeyTreeView(const QString &text, const std::shared_ptr<KeyFilter> &
                          AbstractKeyListSortFilterProxyModel *proxy, QWidget *parent,
                          const KConfigGroup &group)
     : QWidget(parent),
+      m_keys(std::make_shared<std::vector<Key>>()),
       m_proxy(new KeyListSortFilterProxyModel(this)),
       m_additionalProxy(proxy),
+      m_displayCacheProxy(nullptr),
       m_view(new TreeView(this)),
       m_flatModel(nullptr),
       m_hierarchicalModel(nullptr),
@@ -194,7 +391,9 @@ KeyTreeView::KeyTreeView(const QString &text, const std::shared_ptr<KeyFilter> &
       m_keyFilter(kf),
       m_group(group),
       m_isHierarchical(true),
-      m_onceResized(false)
+      m_onceResized(false),
+      m_searchRunning(false),
+      m_searchOutdated(false)
 {
     init();
 }
@@ -291,8 +490,10 @@ void KeyTreeView::init()
         }
     }
 
-    m_proxy->setFilterFixedString(m_stringFilter);
-    m_proxy->setKeyFilter(m_keyFilter);
+    updateProxyFilters();
+    if (m_searchIndex) {
+        connect(m_searchIndex.get(), &KeySearchIndex::indexChanged, this, &KeyTreeView::slotSearchIndexChanged);
+    }
     m_proxy->setSortCaseSensitivity(Qt::CaseInsensitive);
 
     KeyRearrangeColumnsProxyModel *rearangingModel = new KeyRearrangeColumnsProxyModel(this);
@@ -317,6 +518,18 @@ void KeyTreeView::init()
     );
     m_view->setModel(rearangingModel);
 
+    // Keep the column sizing candidates up to date with the rows the
+    // view gets; the widths themselves are only applied by resizeColumns().
+    m_columnSizer.reset(new ColumnSizer);
+    connect(rearangingModel, &QAbstractItemModel::rowsInserted,
+            this, [this, rearangingModel](const QModelIndex &parent, int first, int last) {
+        if (!parent.isValid()) {
+            m_columnSizer->rowsInserted(rearangingModel, first, last);
+        }
+    });
+    connect(rearangingModel, &QAbstractItemModel::modelReset,
+            this, [this]() { m_columnSizer->reset(); });
+
     /* Handle expansion state */
     m_expandedKeys = m_group.readEntry("Expanded", QStringList());
 
@@ -349,13 +562,18 @@ void KeyTreeView::init()
          * the model is already populated. */
         QTimer::singleShot(0, [this] () {
             restoreExpandState();
-            setupRemarkKeys();
             if (!m_onceResized) {
                 m_onceResized = true;
                 resizeColumns();
             }
         });
     });
+
+    m_remarkKeyRegistry = RemarkKeyRegistry::instance();
+    connect(m_remarkKeyRegistry.get(), &RemarkKeyRegistry::remarkKeysChanged,
+            this, &KeyTreeView::setupRemarkKeys);
+    setupRemarkKeys();
+
     resizeColumns();
     restoreLayout();
 }
@@ -391,12 +609,16 @@ void KeyTreeView::restoreExpandState()
 void KeyTreeView::setupRemarkKeys()
 {
 #ifdef GPGME_HAS_REMARKS
-    const auto remarkKeys = Remarks::remarkKeys();
-    if (m_hierarchicalModel) {
-        m_hierarchicalModel->setRemarkKeys(remarkKeys);
-    }
-    if (m_flatModel) {
-        m_flatModel->setRemarkKeys(remarkKeys);
+    // The models are shared between the views, so remember on each model
+    // which generation of the remark keys it got already:
+    static const char generationProperty[] = "_kleo_remarkKeysGeneration";
+    const auto generation = m_remarkKeyRegistry->generation();
+    for (AbstractKeyListModel *const model : { m_hierarchicalModel, m_flatModel }) {
+        if (!model || model->property(generationProperty).toULongLong() == generation) {
+            continue;
+        }
+        model->setRemarkKeys(m_remarkKeyRegistry->remarkKeys());
+        model->setProperty(generationProperty, generation);
     }
 #endif
 }
@@ -483,6 +705,9 @@ void KeyTreeView::restoreLayout()
 
 KeyTreeView::~KeyTreeView()
 {
+    if (m_searchIndex) {
+        m_searchIndex->cancel(this);
+    }
     saveLayout();
 }
 
@@ -506,6 +731,7 @@ void KeyTreeView::setFlatModel(AbstractKeyListModel *model)
     {
         find_last_proxy(m_proxy)->setSourceModel(model);
     }
+    setupRemarkKeys();
 }
 
 void KeyTreeView::setHierarchicalModel(AbstractKeyListModel *model)
@@ -514,6 +740,7 @@ void KeyTreeView::setHierarchicalModel(AbstractKeyListModel *model)
         return;
     }
     m_hierarchicalModel = model;
+    setupRemarkKeys();
     if (m_isHierarchical) {
         find_last_proxy(m_proxy)->setSourceModel(model);
         m_view->expandAll();
@@ -529,7 +756,11 @@ void KeyTreeView::setStringFilter(const QString &filter)
         return;
     }
     m_stringFilter = filter;
-    m_proxy->setFilterFixedString(filter);
+    if (m_searchIndex) {
+        startSearch();
+    } else {
+        updateProxyFilters();
+    }
     Q_EMIT stringFilterChanged(filter);
 }
 
@@ -539,20 +770,108 @@ void KeyTreeView::setKeyFilter(const std::shared_ptr<KeyFilter> &filter)
         return;
     }
     m_keyFilter = filter;
-    m_proxy->setKeyFilter(filter);
+    updateProxyFilters();
     Q_EMIT keyFilterChanged(filter);
 }
 
-static QItemSelection itemSelectionFromKeys(const std::vector<Key> &keys, const KeyListSortFilterProxyModel &proxy)
+void KeyTreeView::setUseSearchIndex(bool on)
+{
+    if (on == bool(m_searchIndex)) {
+        return;
+    }
+    if (on) {
+        m_searchIndex = KeySearchIndex::instance();
+        connect(m_searchIndex.get(), &KeySearchIndex::indexChanged, this, &KeyTreeView::slotSearchIndexChanged);
+        startSearch();
+    } else {
+        m_searchIndex->disconnect(this);
+        m_searchIndex->cancel(this);
+        m_searchIndex.reset();
+        m_searchMatches.reset();
+        m_searchRunning = m_searchOutdated = false;
+        updateProxyFilters();
+    }
+}
+
+void KeyTreeView::setUseDisplayCache(bool on)
 {
-    QItemSelection result;
-    for (const Key &key : keys) {
-        const QModelIndex mi = proxy.index(key);
-        if (mi.isValid()) {
-            result.merge(QItemSelection(mi, mi), QItemSelectionModel::Select);
+    if (on == bool(m_displayCacheProxy)) {
+        return;
+    }
+    if (on) {
+        // the last one in the chain of proxies, right on top of the model:
+        QAbstractProxyModel *const last = find_last_proxy(m_proxy);
+        m_displayCacheProxy = new KeyDisplayCacheProxyModel(this);
+        KDAB_SET_OBJECT_NAME(m_displayCacheProxy);
+        m_displayCacheProxy->setSourceModel(last->sourceModel());
+        last->setSourceModel(m_displayCacheProxy);
+    } else {
+        QAbstractProxyModel *pm = m_proxy;
+        while (pm->sourceModel() != m_displayCacheProxy) {
+            pm = qobject_cast<QAbstractProxyModel *>(pm->sourceModel());
+            Q_ASSERT(pm);
+        }
+        pm->setSourceModel(m_displayCacheProxy->sourceModel());
+        delete m_displayCacheProxy;
+        m_displayCacheProxy = nullptr;
+    }
+}
+
+void KeyTreeView::startSearch()
+{
+    Q_ASSERT(m_searchIndex);
+    if (m_stringFilter.isEmpty()) {
+        m_searchIndex->cancel(this);
+        m_searchRunning = m_searchOutdated = false;
+        if (m_searchMatches || !m_proxy->filterRegExp().isEmpty()) {
+            m_searchMatches.reset();
+            updateProxyFilters();
+        }
+        return;
+    }
+    // keep showing the previous results until the new ones are in
+    m_searchRunning = true;
+    m_searchOutdated = false;
+    m_searchIndex->search(this, m_stringFilter, [this](const std::shared_ptr<const KeySearchIndex::Matches> &matches) {
+        m_searchRunning = false;
+        m_searchMatches = matches;
+        updateProxyFilters();
+        if (m_searchOutdated) {
+            startSearch();
         }
+    });
+}
+
+void KeyTreeView::slotSearchIndexChanged()
+{
+    // don't let a stream of index updates starve the running search:
+    if (m_searchRunning) {
+        m_searchOutdated = true;
+    } else if (!m_stringFilter.isEmpty()) {
+        startSearch();
     }
-    return result;
+}
+
+void KeyTreeView::updateProxyFilters()
+{
+    // share the filter results with all other views using this filter:
+    const std::shared_ptr<KeyFilter> keyFilter = KeyFilterIndex::instance()->indexedFilter(m_keyFilter);
+    if (!m_searchIndex) {
+        m_proxy->setFilterFixedString(m_stringFilter);
+        m_proxy->setKeyFilter(keyFilter);
+    } else if (!m_searchMatches) {
+        // no results yet, so let the proxy do the string matching
+        m_proxy->setFilterFixedString(m_stringFilter);
+        m_proxy->setKeyFilter(keyFilter);
+    } else {
+        m_proxy->setFilterFixedString(QString());
+        m_proxy->setKeyFilter(std::make_shared<SearchResultFilter>(m_searchMatches, keyFilter));
+    }
+}
+
+static QItemSelection itemSelectionFromKeys(const std::vector<Key> &keys, const KeyListSortFilterProxyModel &proxy)
+{
+    return rowSelectionFromIndexes(proxy.indexes(keys));
 }
 
 void KeyTreeView::selectKeys(const std::vector<Key> &keys)
@@ -597,12 +916,43 @@ void KeyTreeView::setHierarchicalView(bool on)
     Q_EMIT hierarchicalChanged(on);
 }
 
+// Returns \a keys sorted by fingerprint and without duplicates. Only if
+// they are not so already, they are copied into \a storage for that.
+static const std::vector<Key> &sorted_unique_by_fpr(const std::vector<Key> &keys, std::vector<Key> &storage)
+{
+    const _detail::ByFingerprint<std::less> less;
+    if (std::adjacent_find(keys.begin(), keys.end(),
+                           [less](const Key &lhs, const Key &rhs) { return !less(lhs, rhs); }) == keys.end()) {
+        return keys;
+    }
+    storage = keys;
+    _detail::sort_by_fpr(storage);
+    _detail::remove_duplicates_by_fpr(storage);
+    return storage;
+}
+
+// Beyond this many removals, resetting the models is cheaper than
+// removing the rows one by one.
+static const unsigned int MAX_SINGLE_ROW_REMOVALS = 100;
+
+std::vector<Key> &KeyTreeView::mutableKeys()
+{
+    // copy-on-write: the set may be shared with the views cloned from this one
+    if (m_keys.use_count() != 1) {
+        m_keys = std::make_shared<std::vector<Key>>(*m_keys);
+    }
+    return *m_keys;
+}
+
 void KeyTreeView::setKeys(const std::vector<Key> &keys)
 {
-    std::vector<Key> sorted = keys;
-    _detail::sort_by_fpr(sorted);
-    _detail::remove_duplicates_by_fpr(sorted);
-    m_keys = sorted;
+    std::vector<Key> storage;
+    const std::vector<Key> &sorted = sorted_unique_by_fpr(keys, storage);
+    if (m_keys.use_count() == 1) {
+        *m_keys = sorted;
+    } else {
+        m_keys = std::make_shared<std::vector<Key>>(sorted);
+    }
     if (m_flatModel) {
         m_flatModel->setKeys(sorted);
     }
@@ -616,17 +966,27 @@ void KeyTreeView::addKeysImpl(const std::vector<Key> &keys, bool select)
     if (keys.empty()) {
         return;
     }
-    if (m_keys.empty()) {
+    if (m_keys->empty()) {
         setKeys(keys);
         return;
     }
 
-    std::vector<Key> sorted = keys;
-    _detail::sort_by_fpr(sorted);
-    _detail::remove_duplicates_by_fpr(sorted);
-
-    std::vector<Key> newKeys = _detail::union_by_fpr(sorted, m_keys);
-    m_keys.swap(newKeys);
+    std::vector<Key> storage;
+    const std::vector<Key> &sorted = sorted_unique_by_fpr(keys, storage);
+
+    // Update the keys that are there already, append the others and
+    // merge them in, all in place:
+    std::vector<Key> &all = mutableKeys();
+    const auto oldEnd = all.size();
+    for (const Key &key : sorted) {
+        const auto it = std::lower_bound(all.begin(), all.begin() + oldEnd, key, _detail::ByFingerprint<std::less>());
+        if (it != all.begin() + oldEnd && _detail::ByFingerprint<std::equal_to>()(*it, key)) {
+            *it = key;
+        } else {
+            all.push_back(key);
+        }
+    }
+    std::inplace_merge(all.begin(), all.begin() + oldEnd, all.end(), _detail::ByFingerprint<std::less>());
 
     if (m_flatModel) {
         m_flatModel->addKeys(sorted);
@@ -655,26 +1015,29 @@ void KeyTreeView::removeKeys(const std::vector<Key> &keys)
     if (keys.empty()) {
         return;
     }
-    std::vector<Key> sorted = keys;
-    _detail::sort_by_fpr(sorted);
-    _detail::remove_duplicates_by_fpr(sorted);
-    std::vector<Key> newKeys;
-    newKeys.reserve(m_keys.size());
-    std::set_difference(m_keys.begin(), m_keys.end(),
-                        sorted.begin(), sorted.end(),
-                        std::back_inserter(newKeys),
-                        _detail::ByFingerprint<std::less>());
-    m_keys.swap(newKeys);
-
-    if (m_flatModel) {
-        std::for_each(sorted.cbegin(), sorted.cend(),
-                      [this](const Key &key) { m_flatModel->removeKey(key); });
-    }
-    if (m_hierarchicalModel) {
-        std::for_each(sorted.cbegin(), sorted.cend(),
-                      [this](const Key &key) { m_hierarchicalModel->removeKey(key); });
+    std::vector<Key> storage;
+    const std::vector<Key> &sorted = sorted_unique_by_fpr(keys, storage);
+
+    std::vector<Key> &all = mutableKeys();
+    all.erase(std::remove_if(all.begin(), all.end(),
+                             [&sorted](const Key &key) {
+                                 return std::binary_search(sorted.begin(), sorted.end(), key,
+                                                           _detail::ByFingerprint<std::less>());
+                             }),
+              all.end());
+
+    for (AbstractKeyListModel *const model : { m_flatModel, m_hierarchicalModel }) {
+        if (!model) {
+            continue;
+        }
+        if (sorted.size() > MAX_SINGLE_ROW_REMOVALS) {
+            // the models show exactly the keys of this view:
+            model->setKeys(all);
+        } else {
+            std::for_each(sorted.cbegin(), sorted.cend(),
+                          [model](const Key &key) { model->removeKey(key); });
+        }
     }
-
 }
 
 static const struct {
@@ -715,7 +1078,5 @@ void KeyTreeView::resizeColumns()
     m_view->setColumnWidth(KeyListModelInterface::PrettyName, 260);
     m_view->setColumnWidth(KeyListModelInterface::PrettyEMail, 260);
 
-    for (int i = 2; i < m_view->model()->columnCount(); ++i) {
-        m_view->resizeColumnToContents(i);
-    }
+    m_columnSizer->resizeColumns(m_view, 2);
 }
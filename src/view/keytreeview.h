@@ -45,12 +45,16 @@
 
 #include <KConfigGroup>
 
+#include <utils/keysearchindex.h>
+#include <utils/remarkkeyregistry.h>
+
 class QTreeView;
 
 namespace Kleo
 {
 
 class KeyFilter;
+class KeyDisplayCacheProxyModel;
 class AbstractKeyListModel;
 class AbstractKeyListSortFilterProxyModel;
 class KeyListSortFilterProxyModel;
@@ -90,7 +94,7 @@ public:
     void setKeys(const std::vector<GpgME::Key> &keys);
     const std::vector<GpgME::Key> &keys() const
     {
-        return m_keys;
+        return *m_keys;
     }
 
     void selectKeys(const std::vector<GpgME::Key> &keys);
@@ -130,6 +134,19 @@ public:
         return new KeyTreeView(*this);
     }
 
+    /**
+     * Answer string filters from the KeySearchIndex in the background
+     * instead of matching every row in the proxy model. Only useful if
+     * the models contain the KeyCache's keys.
+     */
+    void setUseSearchIndex(bool on);
+
+    /**
+     * Take the texts of the keys from the KeyDisplayCache instead of
+     * formatting them again on every paint and sort.
+     */
+    void setUseDisplayCache(bool on);
+
     void disconnectSearchBar(const QObject *bar);
     bool connectSearchBar(const QObject *bar);
     void resizeColumns();
@@ -150,16 +167,22 @@ protected:
 private:
     void init();
     void addKeysImpl(const std::vector<GpgME::Key> &, bool);
+    std::vector<GpgME::Key> &mutableKeys();
     void restoreExpandState();
     void saveLayout();
     void restoreLayout();
     void setupRemarkKeys();
+    void startSearch();
+    void slotSearchIndexChanged();
+    void updateProxyFilters();
 
 private:
-    std::vector<GpgME::Key> m_keys;
+    // sorted by fingerprint; shared with (and copied on write by) cloned views
+    std::shared_ptr<std::vector<GpgME::Key>> m_keys;
 
     KeyListSortFilterProxyModel *m_proxy;
     AbstractKeyListSortFilterProxyModel *m_additionalProxy;
+    KeyDisplayCacheProxyModel *m_displayCacheProxy;
 
     QTreeView *m_view;
 
@@ -169,12 +192,22 @@ private:
     QString m_stringFilter;
     std::shared_ptr<KeyFilter> m_keyFilter;
 
+    std::shared_ptr<KeySearchIndex> m_searchIndex;
+    std::shared_ptr<const KeySearchIndex::Matches> m_searchMatches;
+
+    std::shared_ptr<RemarkKeyRegistry> m_remarkKeyRegistry;
+
+    class ColumnSizer;
+    std::unique_ptr<ColumnSizer> m_columnSizer;
+
     QStringList m_expandedKeys;
 
     KConfigGroup m_group;
 
     bool m_isHierarchical : 1;
     bool m_onceResized : 1;
+    bool m_searchRunning : 1;
+    bool m_searchOutdated : 1;
 };
 
 }
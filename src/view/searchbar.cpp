@@ -43,6 +43,7 @@
 #include <QComboBox>
 #include <QHBoxLayout>
 #include <QPushButton>
+#include <QTimer>
 
 
 #include <utils/gnupg-helper.h>
@@ -115,10 +116,23 @@ private:
         job->start(QStringList());
     }
 
+    void slotTextChanged(const QString &text)
+    {
+        // clearing the search should show everything right away
+        if (text.isEmpty()) {
+            searchTimer.stop();
+            Q_EMIT q->stringFilterChanged(text);
+        } else {
+            searchTimer.start();
+        }
+    }
+
 private:
     QLineEdit *lineEdit;
     QComboBox *combo;
     QPushButton *certifyButton;
+    // don't start a new search for every keystroke:
+    QTimer searchTimer;
 };
 
 SearchBar::Private::Private(SearchBar *qq)
@@ -150,7 +164,20 @@ SearchBar::Private::Private(SearchBar *qq)
     KDAB_SET_OBJECT_NAME(combo);
     KDAB_SET_OBJECT_NAME(certifyButton);
 
-    connect(lineEdit, &QLineEdit::textChanged, q, &SearchBar::stringFilterChanged);
+    searchTimer.setSingleShot(true);
+    searchTimer.setInterval(150);
+    connect(&searchTimer, &QTimer::timeout, q, [this]() {
+        Q_EMIT q->stringFilterChanged(lineEdit->text());
+    });
+    connect(lineEdit, &QLineEdit::textChanged, q, [this](const QString &text) {
+        slotTextChanged(text);
+    });
+    connect(lineEdit, &QLineEdit::returnPressed, q, [this]() {
+        if (searchTimer.isActive()) {
+            searchTimer.stop();
+            Q_EMIT q->stringFilterChanged(lineEdit->text());
+        }
+    });
     connect(combo, SIGNAL(currentIndexChanged(int)), q, SLOT(slotKeyFilterChanged(int)));
     connect(certifyButton, SIGNAL(clicked()), q, SLOT(listNotCertifiedKeys()));
 }
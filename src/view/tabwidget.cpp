@@ -216,7 +216,9 @@ Page::Page(const KConfigGroup &group, QWidget *parent)
 
 void Page::init()
 {
-
+    // pages always show the KeyCache's keys
+    setUseSearchIndex(true);
+    setUseDisplayCache(true);
 }
 
 Page::~Page() {}
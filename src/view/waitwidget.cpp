@@ -26,9 +26,13 @@ WaitWidget::WaitWidget(QWidget *parent)
     : QWidget(parent)
 {
     auto vLay = new QVBoxLayout(this);
-    auto bar = new QProgressBar;
+    mBar = new QProgressBar;
     mLabel = new QLabel;
-    bar->setRange(0, 0);
+    mDetails = new QLabel;
+    mDetails->setAlignment(Qt::AlignCenter);
+    mDetails->setVisible(false);
+    mBar->setRange(0, 0);
+    mBar->setTextVisible(false);
     vLay->addStretch(1);
 
     auto subLay1 = new QVBoxLayout;
@@ -37,7 +41,8 @@ WaitWidget::WaitWidget(QWidget *parent)
     subLay3->addWidget(mLabel);
     subLay3->addStretch(1);
     subLay1->addLayout(subLay3);
-    subLay1->addWidget(bar);
+    subLay1->addWidget(mBar);
+    subLay1->addWidget(mDetails);
 
     auto subLay2 = new QHBoxLayout;
     subLay2->addStretch(0);
@@ -54,6 +59,18 @@ void WaitWidget::setText(const QString &text)
     mLabel->setText(QStringLiteral("<h3>%1</h3>").arg(text));
 }
 
+void WaitWidget::setProgress(int value, int maximum)
+{
+    mBar->setRange(0, maximum);
+    mBar->setValue(value);
+}
+
+void WaitWidget::setDetails(const QString &details)
+{
+    mDetails->setText(details);
+    mDetails->setVisible(!details.isEmpty());
+}
+
 WaitWidget::~WaitWidget()
 {
 }
@@ -21,6 +21,7 @@
 #include <QWidget>
 
 class QLabel;
+class QProgressBar;
 
 namespace Kleo
 {
@@ -35,8 +36,16 @@ public:
 
     void setText(const QString &text);
 
+    /** Shows @p value out of @p maximum. A @p maximum of 0 shows a busy indicator. */
+    void setProgress(int value, int maximum);
+
+    /** Sets a line of details shown below the progress bar. */
+    void setDetails(const QString &details);
+
 private:
     QLabel *mLabel;
+    QLabel *mDetails;
+    QProgressBar *mBar;
 };
 
 } // namespace Kleo
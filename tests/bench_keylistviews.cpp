@@ -0,0 +1,374 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    tests/bench_keylistviews.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+
+//
+// Usage: bench_keylistviews [--sizes <n>[,<n>...]] [--output <file>]
+//                           [--baseline <file> [--tolerance <factor>]]
+//
+// Times the key list views against synthetic keyrings of (by default)
+// 1000, 10000 and 100000 certificates, half OpenPGP, half X.509, and
+// writes the timings as JSON. With --baseline, the timings are compared
+// against an earlier run, and the exit code is 1 if any of them got
+// slower than tolerance (default: 1.5) times the baseline.
+//
+// The certificates are created in memory instead of in a GnuPG home:
+// generating and listing 100000 real keys would take hours and would
+// time GnuPG rather than the views. Run with QT_QPA_PLATFORM=offscreen
+// if there is no display.
+//
+
+#include <config-kleopatra.h>
+
+#include "view/keytreeview.h"
+#include "view/searchbar.h"
+#include "view/tabwidget.h"
+#include "utils/keysearchindex.h"
+
+#include <Libkleo/KeyCache>
+#include <Libkleo/KeyFilter>
+#include <Libkleo/KeyFilterManager>
+#include <Libkleo/KeyListModel>
+
+#include <gpgme.h>
+#include <gpgme++/key.h>
+
+#include <QAbstractItemView>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QItemSelectionModel>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLineEdit>
+#include <QStringList>
+#include <QTest>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace Kleo;
+using namespace GpgME;
+
+// how long to wait for asynchronous work (searches) to show up in a view
+static const int TIMEOUT_MS = 120000;
+
+static Key makeKey(unsigned int n)
+{
+    const bool openpgp = n % 2 == 0;
+    const QByteArray num = QByteArray::number(n);
+    const QByteArray uid = openpgp
+                           ? "User " + num + " <user" + num + "@example.org>"
+                           : "CN=User " + num + ",O=Example Org,C=DE";
+    gpgme_key_t key = nullptr;
+    if (gpgme_key_from_uid(&key, uid.constData()) || !key) {
+        return Key();
+    }
+    const QByteArray fpr = QByteArray::number(n + 1, 16).toUpper().rightJustified(40, '0');
+
+    key->protocol = openpgp ? GPGME_PROTOCOL_OpenPGP : GPGME_PROTOCOL_CMS;
+    key->fpr = strdup(fpr.constData());
+    key->can_encrypt = key->can_sign = key->can_certify = 1;
+    key->secret = n % 10 == 0;
+    key->expired = n % 50 == 1;
+    key->revoked = n % 97 == 2;
+    key->owner_trust = n % 3 == 0 ? GPGME_VALIDITY_FULL : GPGME_VALIDITY_UNKNOWN;
+    key->uids->validity = key->owner_trust;
+    if (!openpgp) {
+        key->issuer_name = strdup("CN=Synthetic CA,O=Example Org,C=DE");
+    }
+
+    const auto subkey = static_cast<gpgme_subkey_t>(calloc(1, sizeof(struct _gpgme_subkey)));
+    subkey->fpr = strdup(fpr.constData());
+    std::memcpy(subkey->_keyid, fpr.constData() + 24, 16);
+    subkey->keyid = subkey->_keyid;
+    subkey->pubkey_algo = GPGME_PK_RSA;
+    subkey->length = 3072;
+    subkey->timestamp = 1577836800 + n;
+    subkey->can_encrypt = subkey->can_sign = subkey->can_certify = 1;
+    subkey->secret = key->secret;
+    subkey->expired = key->expired;
+    subkey->revoked = key->revoked;
+    key->subkeys = key->_last_subkey = subkey;
+
+    return Key(key, false);
+}
+
+static int topLevelRows(const QAbstractItemView *view)
+{
+    return view->model()->rowCount();
+}
+
+namespace
+{
+class Timings
+{
+public:
+    template <typename F>
+    void time(const char *name, F f)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        f();
+        m_timings.insert(QLatin1String(name), timer.nsecsElapsed() / 1.0e6);
+    }
+
+    // times f() plus the event processing until done() holds
+    template <typename F, typename D>
+    bool timeUntil(const char *name, F f, D done)
+    {
+        bool ok = false;
+        time(name, [&]() {
+            f();
+            ok = QTest::qWaitFor(done, TIMEOUT_MS);
+        });
+        if (!ok) {
+            std::cerr << "bench_keylistviews: timeout in " << name << std::endl;
+        }
+        return ok;
+    }
+
+    QJsonObject toJson() const
+    {
+        return m_timings;
+    }
+
+private:
+    QJsonObject m_timings;
+};
+}
+
+static QJsonObject runBenchmark(unsigned int size)
+{
+    std::vector<Key> keys;
+    keys.reserve(size);
+    for (unsigned int n = 0; n < size; ++n) {
+        keys.push_back(makeKey(n));
+    }
+    // every 100th key, for the add/remove flows
+    std::vector<Key> someKeys;
+    for (unsigned int n = 0; n < size; n += 100) {
+        someKeys.push_back(keys[n]);
+    }
+
+    Timings timings;
+
+    // KeyCache is a weak singleton; keep it alive until the keys are removed
+    // again, or the inserted keys are gone before the views get to them.
+    // The search index follows the KeyCache, so it has to be there first:
+    const std::shared_ptr<KeyCache> keyCache = KeyCache::mutableInstance();
+    const std::shared_ptr<KeySearchIndex> searchIndex = KeySearchIndex::instance();
+    timings.time("keyCacheInsert", [&]() { keyCache->insert(keys); });
+
+    {
+        KeyTreeView view;
+        view.setFlatModel(AbstractKeyListModel::createFlatKeyListModel(&view));
+        view.setHierarchicalModel(AbstractKeyListModel::createHierarchicalKeyListModel(&view));
+        timings.time("keyTreeViewSetKeys", [&]() { view.setKeys(keys); });
+        timings.time("keyTreeViewRemoveKeys", [&]() { view.removeKeys(someKeys); });
+        timings.time("keyTreeViewAddKeys", [&]() { view.addKeysUnselected(someKeys); });
+        timings.time("keyTreeViewSelectKeys", [&]() { view.selectKeys(someKeys); });
+        timings.time("keyTreeViewResizeColumns", [&]() { view.resizeColumns(); });
+    }
+
+    {
+        TabWidget tabWidget;
+        SearchBar searchBar;
+        tabWidget.connectSearchBar(&searchBar);
+        AbstractKeyListModel *const flatModel = AbstractKeyListModel::createFlatKeyListModel(&tabWidget);
+        AbstractKeyListModel *const hierarchicalModel = AbstractKeyListModel::createHierarchicalKeyListModel(&tabWidget);
+        timings.time("modelsAddKeys", [&]() {
+            flatModel->addKeys(keys);
+            hierarchicalModel->addKeys(keys);
+        });
+        tabWidget.setFlatModel(flatModel);
+        tabWidget.setHierarchicalModel(hierarchicalModel);
+        QAbstractItemView *const view = tabWidget.addView(QStringLiteral("All"));
+        tabWidget.show();
+        searchBar.show();
+        QCoreApplication::processEvents();
+
+        // key filters, one after another, on the current page:
+        const std::shared_ptr<KeyFilterManager> kfm = KeyFilterManager::instance();
+        timings.time("tabWidgetKeyFilters", [&]() {
+            for (int row = 0; row < kfm->model()->rowCount(); ++row) {
+                tabWidget.setKeyFilter(kfm->fromModelIndex(kfm->model()->index(row, 0)));
+            }
+            tabWidget.setKeyFilter(std::shared_ptr<KeyFilter>());
+        });
+
+        // a search that finds a single key, and back:
+        const int allRows = topLevelRows(view);
+        const QString fpr = QString::fromLatin1(keys[size / 2].primaryFingerprint());
+        timings.timeUntil("searchBarSearch", [&]() {
+            searchBar.lineEdit()->setText(fpr);
+            QTest::keyClick(searchBar.lineEdit(), Qt::Key_Return);
+        }, [&]() { return topLevelRows(view) == 1; });
+        timings.timeUntil("searchBarClear", [&]() {
+            searchBar.lineEdit()->clear();
+        }, [&]() { return topLevelRows(view) == allRows; });
+
+        // what KeyListController::enableDisableActions() starts from:
+        timings.time("selectAll", [&]() {
+            view->selectAll();
+            const auto selected = tabWidget.currentModel()->keys(view->selectionModel()->selectedRows());
+            Q_UNUSED(selected);
+        });
+        view->clearSelection();
+    }
+
+    timings.time("keyCacheRemove", [&]() { keyCache->remove(keys); });
+
+    QJsonObject result;
+    result.insert(QStringLiteral("keys"), static_cast<int>(size));
+    result.insert(QStringLiteral("timings_ms"), timings.toJson());
+    return result;
+}
+
+// Returns the names of the timings that are more than tolerance times
+// slower than in the baseline run.
+static QStringList regressions(const QJsonArray &results, const QJsonArray &baseline, double tolerance)
+{
+    QStringList slower;
+    for (const QJsonValue &base : baseline) {
+        const int size = base.toObject().value(QStringLiteral("keys")).toInt();
+        for (const QJsonValue &current : results) {
+            if (current.toObject().value(QStringLiteral("keys")).toInt() != size) {
+                continue;
+            }
+            const QJsonObject baseTimings = base.toObject().value(QStringLiteral("timings_ms")).toObject();
+            const QJsonObject timings = current.toObject().value(QStringLiteral("timings_ms")).toObject();
+            for (auto it = baseTimings.constBegin(); it != baseTimings.constEnd(); ++it) {
+                const double before = it.value().toDouble();
+                const double now = timings.value(it.key()).toDouble();
+                // ignore noise in the sub-millisecond range
+                if (now > 1.0 && now > tolerance * before) {
+                    slower << QStringLiteral("%1@%2: %3 ms -> %4 ms").arg(it.key()).arg(size).arg(before).arg(now);
+                }
+            }
+        }
+    }
+    return slower;
+}
+
+static void usage(const char *msg = nullptr)
+{
+    if (msg) {
+        std::cerr << "bench_keylistviews: " << msg << std::endl;
+    }
+    std::cerr << "Usage: bench_keylistviews [--sizes <n>[,<n>...]] [--output <file>]\n"
+                 "                          [--baseline <file> [--tolerance <factor>]]" << std::endl;
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+
+    std::vector<unsigned int> sizes = { 1000, 10000, 100000 };
+    QString output;
+    QString baselineFile;
+    double tolerance = 1.5;
+
+    const QStringList args = QCoreApplication::arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if (i + 1 >= args.size()) {
+            usage("missing argument");
+        }
+        const QString &arg = args[i];
+        const QString &value = args[++i];
+        if (arg == QLatin1String("--sizes")) {
+            sizes.clear();
+            for (const QString &s : value.split(QLatin1Char(','))) {
+                bool ok = false;
+                sizes.push_back(s.toUInt(&ok));
+                if (!ok || !sizes.back()) {
+                    usage("invalid --sizes");
+                }
+            }
+        } else if (arg == QLatin1String("--output")) {
+            output = value;
+        } else if (arg == QLatin1String("--baseline")) {
+            baselineFile = value;
+        } else if (arg == QLatin1String("--tolerance")) {
+            bool ok = false;
+            tolerance = value.toDouble(&ok);
+            if (!ok || tolerance <= 0) {
+                usage("invalid --tolerance");
+            }
+        } else {
+            usage("unknown option");
+        }
+    }
+
+    QJsonArray results;
+    for (const unsigned int size : sizes) {
+        std::cerr << "bench_keylistviews: " << size << " keys..." << std::endl;
+        results.append(runBenchmark(size));
+    }
+
+    QJsonObject report;
+    report.insert(QStringLiteral("benchmark"), QStringLiteral("keylistviews"));
+    report.insert(QStringLiteral("qt"), QLatin1String(qVersion()));
+    report.insert(QStringLiteral("results"), results);
+    const QByteArray json = QJsonDocument(report).toJson();
+
+    if (output.isEmpty()) {
+        std::cout << json.constData();
+    } else {
+        QFile file(output);
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            std::cerr << "bench_keylistviews: cannot write " << qPrintable(output) << std::endl;
+            return 2;
+        }
+    }
+
+    if (!baselineFile.isEmpty()) {
+        QFile file(baselineFile);
+        if (!file.open(QIODevice::ReadOnly)) {
+            std::cerr << "bench_keylistviews: cannot read " << qPrintable(baselineFile) << std::endl;
+            return 2;
+        }
+        const QJsonArray baseline = QJsonDocument::fromJson(file.readAll()).object().value(QStringLiteral("results")).toArray();
+        const QStringList slower = regressions(results, baseline, tolerance);
+        for (const QString &s : slower) {
+            std::cerr << "bench_keylistviews: slower: " << qPrintable(s) << std::endl;
+        }
+        return slower.isEmpty() ? 0 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,537 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    tests/bench_uiserver.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    Copyright (c) 2020 g10code GmbH
+
+    Kleopatra is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kleopatra is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+
+//
+// Usage: bench_uiserver [<options>]
+//
+// Spawns a number of concurrent Assuan clients against a running (or
+// spawned) Kleopatra UI server, replays a configurable mix of commands
+// and reports throughput, latency percentiles and server memory usage.
+//
+
+#include <config-kleopatra.h>
+
+#include <kleo-assuan.h>
+#include <gpg-error.h>
+
+#include <Libkleo/Exception>
+
+#include "utils/wsastarter.h"
+#include "utils/hex.h"
+
+#include <QDir>
+#include <QFile>
+#include <QScopeGuard>
+#include <QTemporaryDir>
+
+#ifndef Q_OS_WIN32
+# include <unistd.h>
+# include <sys/types.h>
+# include <sys/wait.h>
+# include <signal.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Kleo;
+
+#ifdef Q_OS_WIN32
+static const bool HAVE_FD_PASSING = false;
+#else
+static const bool HAVE_FD_PASSING = true;
+#endif
+
+static const unsigned int ASSUAN_CONNECT_FLAGS = HAVE_FD_PASSING ? 1 : 0;
+
+enum Operation {
+    Echo,
+    PrepEncrypt,
+    Encrypt,
+    Sign,
+    DecryptVerify,
+
+    NumOperations
+};
+
+static const char *const operationNames[NumOperations] = {
+    "echo",
+    "prep_encrypt",
+    "encrypt",
+    "sign",
+    "decrypt_verify",
+};
+
+struct Config {
+    Config()
+        : socket(),
+          spawn(),
+          clients(4),
+          iterations(100),
+          payloadSize(4096),
+          recipient(),
+          sender(),
+          message(KLEO_TEST_DATADIR "/test.data.gpg"),
+          workDir()
+    {
+        std::fill(weights, weights + NumOperations, 0);
+        weights[Echo] = 1;
+    }
+
+    std::string socket;
+    std::string spawn;
+    unsigned int clients;
+    unsigned int iterations;
+    unsigned int payloadSize;
+    std::string recipient;
+    std::string sender;
+    std::string message;
+    std::string workDir;
+    unsigned int weights[NumOperations];
+};
+
+struct Sample {
+    Operation op;
+    double msecs;
+    bool error;
+};
+
+static void usage(const std::string &msg = std::string())
+{
+    std::cerr << msg << std::endl <<
+              "\n"
+              "Usage: bench_uiserver [--socket <socket>] [--spawn <kleopatra>] [--clients <n>]\n"
+              "                      [--iterations <n>] [--payload <bytes>] [--mix <mix>]\n"
+              "                      [--recipient <mailbox>] [--sender <mailbox>] [--message <file>]\n"
+              "where:\n"
+              "  <mix>: comma-separated list of <operation>=<weight>, e.g. echo=4,encrypt=1\n"
+              "         operations: echo, prep_encrypt, encrypt, sign, decrypt_verify\n"
+              "\n"
+              "Without --socket, the socket in " KLEO_TEST_GNUPGHOME " is used. With --spawn,\n"
+              "the given kleopatra binary is started with GNUPGHOME pointing there.\n";
+    exit(1);
+}
+
+static bool parse_mix(const std::string &mix, unsigned int weights[NumOperations])
+{
+    std::fill(weights, weights + NumOperations, 0);
+    std::stringstream ss(mix);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        const size_t pos = item.find('=');
+        const std::string name = item.substr(0, pos);
+        const unsigned int weight = pos == std::string::npos ? 1 : std::atoi(item.c_str() + pos + 1);
+        const char *const *const it = std::find_if(operationNames, operationNames + NumOperations,
+                                                   [&name](const char *n) { return name == n; });
+        if (it == operationNames + NumOperations) {
+            return false;
+        }
+        weights[it - operationNames] = weight;
+    }
+    return std::any_of(weights, weights + NumOperations, [](unsigned int w) { return w > 0; });
+}
+
+#ifndef HAVE_ASSUAN2
+static assuan_error_t collect_data(void *void_str, const void *buffer, size_t len)
+{
+#else
+static gpg_error_t collect_data(void *void_str, const void *buffer, size_t len)
+{
+#endif
+    if (void_str) {
+        static_cast<std::string *>(void_str)->append(static_cast<const char *>(buffer), len);
+    }
+    return 0;
+}
+
+static assuan_context_t connect_to_server(const std::string &socket, unsigned int timeoutSecs)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeoutSecs);
+    while (true) {
+        assuan_context_t ctx = nullptr;
+#ifndef HAVE_ASSUAN2
+        const gpg_error_t err = assuan_socket_connect_ext(&ctx, socket.c_str(), -1, ASSUAN_CONNECT_FLAGS);
+#else
+        if (const gpg_error_t err = assuan_new(&ctx)) {
+            std::cerr << Exception(err, "assuan_new").what() << std::endl;
+            return nullptr;
+        }
+        const gpg_error_t err = assuan_socket_connect(ctx, socket.c_str(), -1, ASSUAN_CONNECT_FLAGS);
+#endif
+        if (!err) {
+            return ctx;
+        }
+#ifdef HAVE_ASSUAN2
+        assuan_release(ctx);
+#endif
+        if (std::chrono::steady_clock::now() >= deadline) {
+            std::cerr << Exception(err, "assuan_socket_connect").what() << std::endl;
+            return nullptr;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+static void disconnect_from_server(assuan_context_t ctx)
+{
+#ifndef HAVE_ASSUAN2
+    assuan_disconnect(ctx);
+#else
+    assuan_release(ctx);
+#endif
+}
+
+static gpg_error_t transact(assuan_context_t ctx, const std::string &line, std::string *data = nullptr)
+{
+    return assuan_transact(ctx, line.c_str(), collect_data, data, nullptr, nullptr, nullptr, nullptr);
+}
+
+static gpg_error_t set_io(assuan_context_t ctx, const char *what, const std::string &file)
+{
+    return transact(ctx, std::string(what) + " FILE=" + hexencode(file));
+}
+
+static gpg_error_t run_operation(assuan_context_t ctx, Operation op, const Config &config,
+                                 const std::string &input, const std::string &output)
+{
+    gpg_error_t err = 0;
+    switch (op) {
+    case Echo:
+        if (!(err = set_io(ctx, "INPUT", input)) && !(err = set_io(ctx, "OUTPUT", output))) {
+            err = transact(ctx, "ECHO --text=bench");
+        }
+        break;
+    case PrepEncrypt:
+        if (!(err = transact(ctx, "RECIPIENT " + config.recipient))) {
+            err = transact(ctx, "PREP_ENCRYPT --protocol=OpenPGP");
+        }
+        break;
+    case Encrypt:
+        if (!(err = transact(ctx, "RECIPIENT " + config.recipient))
+            && !(err = set_io(ctx, "INPUT", input)) && !(err = set_io(ctx, "OUTPUT", output))) {
+            err = transact(ctx, "ENCRYPT --protocol=OpenPGP");
+        }
+        break;
+    case Sign:
+        if (!(err = transact(ctx, "SENDER " + config.sender))
+            && !(err = set_io(ctx, "INPUT", input)) && !(err = set_io(ctx, "OUTPUT", output))) {
+            err = transact(ctx, "SIGN --protocol=OpenPGP --detached");
+        }
+        break;
+    case DecryptVerify:
+        if (!(err = set_io(ctx, "INPUT", config.message)) && !(err = set_io(ctx, "OUTPUT", output))) {
+            err = transact(ctx, "DECRYPT_VERIFY --protocol=OpenPGP");
+        }
+        break;
+    case NumOperations:
+        break;
+    }
+    // leave the connection in a clean state for the next operation:
+    transact(ctx, "RESET");
+    return err;
+}
+
+static bool write_file(const std::string &fileName, const std::string &content)
+{
+    std::ofstream file(fileName.c_str(), std::ios::binary | std::ios::trunc);
+    file << content;
+    return file.good();
+}
+
+static std::string make_payload(unsigned int size)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789\n";
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<unsigned int> dist(0, sizeof alphabet - 2);
+    std::string result;
+    result.reserve(size);
+    for (unsigned int i = 0; i < size; ++i) {
+        result.push_back(alphabet[dist(rng)]);
+    }
+    return result;
+}
+
+static void run_client(unsigned int id, const Config &config, const std::string &input,
+                       std::vector<Sample> &samples, std::mutex &mutex)
+{
+    const std::string output = config.workDir + "/output-" + std::to_string(id);
+    if (!write_file(output, std::string())) {
+        std::cerr << "client " << id << ": cannot create " << output << std::endl;
+        return;
+    }
+
+    assuan_context_t ctx = connect_to_server(config.socket, 5);
+    if (!ctx) {
+        return;
+    }
+
+    std::discrete_distribution<unsigned int> pick(config.weights, config.weights + NumOperations);
+    std::mt19937 rng(id);
+
+    std::vector<Sample> local;
+    local.reserve(config.iterations);
+    for (unsigned int i = 0; i < config.iterations; ++i) {
+        const Operation op = static_cast<Operation>(pick(rng));
+        const auto start = std::chrono::steady_clock::now();
+        const gpg_error_t err = run_operation(ctx, op, config, input, output);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        local.push_back({op, elapsed.count(), err != 0});
+    }
+
+    disconnect_from_server(ctx);
+
+    const std::lock_guard<std::mutex> locker(mutex);
+    samples.insert(samples.end(), local.begin(), local.end());
+}
+
+static long server_rss_kb(const std::string &socket)
+{
+#ifdef Q_OS_WIN32
+    (void)socket;
+    return -1;
+#else
+    assuan_context_t ctx = connect_to_server(socket, 5);
+    if (!ctx) {
+        return -1;
+    }
+    std::string pid;
+    const gpg_error_t err = transact(ctx, "GETINFO pid", &pid);
+    disconnect_from_server(ctx);
+    if (err || pid.empty()) {
+        return -1;
+    }
+    std::ifstream status(("/proc/" + pid + "/status").c_str());
+    std::string line;
+    while (std::getline(status, line))
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            return std::atol(line.c_str() + 6);
+        }
+    return -1;
+#endif
+}
+
+static std::string server_stats(const std::string &socket)
+{
+    std::string stats;
+    if (assuan_context_t ctx = connect_to_server(socket, 5)) {
+        if (transact(ctx, "GETINFO x-stats", &stats)) {
+            stats.clear();
+        }
+        disconnect_from_server(ctx);
+    }
+    return stats;
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    const size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(p / 100.0 * sorted.size()));
+    return sorted[idx];
+}
+
+static void report(const std::vector<Sample> &samples, double wallSecs)
+{
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "operations: " << samples.size()
+              << "  wall time: " << wallSecs << " s"
+              << "  throughput: " << (wallSecs > 0 ? samples.size() / wallSecs : 0) << " ops/s" << std::endl;
+    std::cout << std::left << std::setw(16) << "operation" << std::right
+              << std::setw(8) << "count" << std::setw(8) << "errors"
+              << std::setw(12) << "p50 ms" << std::setw(12) << "p95 ms"
+              << std::setw(12) << "p99 ms" << std::setw(12) << "max ms" << std::endl;
+    for (unsigned int op = 0; op < NumOperations; ++op) {
+        std::vector<double> msecs;
+        unsigned int errors = 0;
+        for (const Sample &s : samples)
+            if (s.op == static_cast<Operation>(op)) {
+                msecs.push_back(s.msecs);
+                errors += s.error;
+            }
+        if (msecs.empty()) {
+            continue;
+        }
+        std::sort(msecs.begin(), msecs.end());
+        std::cout << std::left << std::setw(16) << operationNames[op] << std::right
+                  << std::setw(8) << msecs.size() << std::setw(8) << errors
+                  << std::setw(12) << percentile(msecs, 50) << std::setw(12) << percentile(msecs, 95)
+                  << std::setw(12) << percentile(msecs, 99) << std::setw(12) << msecs.back() << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+
+    const Kleo::WSAStarter _wsastarter;
+
+#ifndef HAVE_ASSUAN2
+    assuan_set_assuan_err_source(GPG_ERR_SOURCE_DEFAULT);
+#else
+    assuan_set_gpg_err_source(GPG_ERR_SOURCE_DEFAULT);
+#endif
+
+    Config config;
+    for (int optind = 1; optind < argc; ++optind) {
+        const std::string arg = argv[optind];
+        if (optind + 1 >= argc) {
+            usage("Missing argument for " + arg);
+        }
+        const char *const value = argv[++optind];
+        if (arg == "--socket") {
+            config.socket = value;
+        } else if (arg == "--spawn") {
+            config.spawn = value;
+        } else if (arg == "--clients") {
+            config.clients = std::max(1, std::atoi(value));
+        } else if (arg == "--iterations") {
+            config.iterations = std::max(1, std::atoi(value));
+        } else if (arg == "--payload") {
+            config.payloadSize = std::max(0, std::atoi(value));
+        } else if (arg == "--mix") {
+            if (!parse_mix(value, config.weights)) {
+                usage("Invalid --mix: " + std::string(value));
+            }
+        } else if (arg == "--recipient") {
+            config.recipient = value;
+        } else if (arg == "--sender") {
+            config.sender = value;
+        } else if (arg == "--message") {
+            config.message = value;
+        } else {
+            usage("Unknown option " + arg);
+        }
+    }
+    if ((config.weights[PrepEncrypt] || config.weights[Encrypt]) && config.recipient.empty()) {
+        usage("prep_encrypt and encrypt need --recipient");
+    }
+    if (config.weights[Sign] && config.sender.empty()) {
+        usage("sign needs --sender");
+    }
+    if (config.socket.empty()) {
+        config.socket = KLEO_TEST_GNUPGHOME "/S.uiserver";
+    }
+
+#ifdef Q_OS_WIN32
+    if (!config.spawn.empty()) {
+        usage("--spawn is not supported on this platform");
+    }
+#endif
+
+    // removed again, with everything in it, when we return:
+    const QTemporaryDir tmpDir(QDir::tempPath() + QStringLiteral("/bench_uiserver.XXXXXX"));
+    if (!tmpDir.isValid()) {
+        std::cerr << "cannot create a temporary directory" << std::endl;
+        return 1;
+    }
+    config.workDir = QFile::encodeName(tmpDir.path()).toStdString();
+
+#ifndef Q_OS_WIN32
+    pid_t server = -1;
+    // stops a spawned server on every way out of main():
+    const auto stopServer = qScopeGuard([&server]() {
+        if (server > 0) {
+            kill(server, SIGTERM);
+            waitpid(server, nullptr, 0);
+        }
+    });
+    if (!config.spawn.empty()) {
+        server = fork();
+        if (server == -1) {
+            perror("fork");
+            return 1;
+        }
+        if (server == 0) {
+            setenv("GNUPGHOME", KLEO_TEST_GNUPGHOME, 1);
+            execl(config.spawn.c_str(), config.spawn.c_str(), "--daemon", static_cast<char *>(nullptr));
+            perror("execl");
+            _exit(1);
+        }
+    }
+#endif
+
+    const std::string input = config.workDir + "/input";
+    if (!write_file(input, make_payload(config.payloadSize))) {
+        std::cerr << "cannot create " << input << std::endl;
+        return 1;
+    }
+
+    // also waits for a spawned server to come up:
+    if (assuan_context_t ctx = connect_to_server(config.socket, 60)) {
+        disconnect_from_server(ctx);
+    } else {
+        return 1;
+    }
+
+    const long rssBefore = server_rss_kb(config.socket);
+
+    std::vector<Sample> samples;
+    samples.reserve(config.clients * config.iterations);
+    std::mutex mutex;
+    std::vector<std::thread> clients;
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < config.clients; ++i) {
+        clients.emplace_back(run_client, i, std::cref(config), std::cref(input), std::ref(samples), std::ref(mutex));
+    }
+    for (std::thread &t : clients) {
+        t.join();
+    }
+    const std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+
+    const long rssAfter = server_rss_kb(config.socket);
+
+    std::cout << "clients: " << config.clients << "  iterations per client: " << config.iterations
+              << "  payload: " << config.payloadSize << " bytes" << std::endl;
+    report(samples, wall.count());
+    std::cout << "server RSS: " << rssBefore << " kB before, " << rssAfter << " kB after" << std::endl;
+
+    const std::string stats = server_stats(config.socket);
+    if (!stats.empty()) {
+        std::cout << "server statistics (GETINFO x-stats, usecs):" << std::endl << stats;
+    }
+
+    return samples.size() == config.clients * config.iterations ? 0 : 1;
+}